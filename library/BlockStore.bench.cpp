@@ -0,0 +1,73 @@
+#include "BlockStore.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+using namespace DFHack;
+
+namespace {
+    struct Payload {
+        static int live;
+        int32_t x, y, z;
+        int32_t data[256];
+        Payload(int32_t x, int32_t y, int32_t z) : x(x), y(y), z(z), data{} { live++; }
+        ~Payload() { live--; }
+    };
+    int Payload::live = 0;
+}
+
+// Compares a full-map, tile-by-tile walk against the std::map + new storage
+// that MapCache used before.
+TEST(BlockStore, full_map_walk) {
+    const int32_t X = 16, Y = 16, Z = 32;
+    typedef std::chrono::steady_clock clock;
+    int64_t sum_map = 0, sum_store = 0;
+
+    auto walk = [&](auto block_at) {
+        int64_t sum = 0;
+        for (int32_t z = 0; z < Z; z++)
+            for (int32_t ty = 0; ty < Y * 16; ty++)
+                for (int32_t tx = 0; tx < X * 16; tx++)
+                    sum += block_at(tx >> 4, ty >> 4, z)->data[(ty & 15) * 16 + (tx & 15)] + 1;
+        return sum;
+    };
+
+    auto t0 = clock::now();
+    {
+        std::map<std::tuple<int32_t, int32_t, int32_t>, Payload*> blocks;
+        sum_map = walk([&](int32_t x, int32_t y, int32_t z) {
+            auto key = std::make_tuple(x, y, z);
+            auto it = blocks.find(key);
+            if (it != blocks.end())
+                return it->second;
+            Payload *p = new Payload(x, y, z);
+            blocks[key] = p;
+            return p;
+        });
+        for (auto &entry : blocks)
+            delete entry.second;
+    }
+    auto t1 = clock::now();
+    {
+        BlockStore<Payload> blocks(X, Y, Z);
+        sum_store = walk([&](int32_t x, int32_t y, int32_t z) {
+            if (Payload *p = blocks.find(x, y, z))
+                return p;
+            return blocks.emplace(x, y, z, x, y, z);
+        });
+    }
+    auto t2 = clock::now();
+
+    EXPECT_EQ(sum_map, sum_store);
+    EXPECT_EQ(Payload::live, 0);
+
+    using std::chrono::microseconds;
+    using std::chrono::duration_cast;
+    std::cout << "full map walk over " << X * Y * Z << " blocks: std::map "
+              << duration_cast<microseconds>(t1 - t0).count() << " us, BlockStore "
+              << duration_cast<microseconds>(t2 - t1).count() << " us" << std::endl;
+}
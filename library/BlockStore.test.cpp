@@ -0,0 +1,82 @@
+#include "BlockStore.h"
+
+#include <gtest/gtest.h>
+
+using namespace DFHack;
+
+namespace {
+    struct Payload {
+        static int live;
+        int32_t x, y, z;
+        int32_t data[256];
+        Payload(int32_t x, int32_t y, int32_t z) : x(x), y(y), z(z), data{} { live++; }
+        ~Payload() { live--; }
+    };
+    int Payload::live = 0;
+}
+
+TEST(BlockStore, emplace_find) {
+    BlockStore<Payload, 4> store(4, 3, 2);
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(store.find(1, 1, 1), nullptr);
+
+    Payload *p = store.emplace(1, 2, 1, 1, 2, 1);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(p->x, 1);
+    EXPECT_EQ(p->y, 2);
+    EXPECT_EQ(store.find(1, 2, 1), p);
+    EXPECT_EQ(store.emplace(1, 2, 1, 0, 0, 0), p);
+    EXPECT_EQ(store.size(), 1);
+
+    EXPECT_EQ(store.emplace(4, 0, 0, 4, 0, 0), nullptr);
+    EXPECT_EQ(store.emplace(0, -1, 0, 0, -1, 0), nullptr);
+    EXPECT_EQ(store.emplace(0, 0, 2, 0, 0, 2), nullptr);
+    EXPECT_EQ(store.find(-1, 0, 0), nullptr);
+    EXPECT_EQ(store.size(), 1);
+}
+
+TEST(BlockStore, erase_reuses_slots) {
+    Payload::live = 0;
+    {
+        BlockStore<Payload, 4> store(8, 8, 1);
+        for (int i = 0; i < 6; i++)
+            store.emplace(i, 0, 0, i, 0, 0);
+        EXPECT_EQ(Payload::live, 6);
+
+        Payload *p = store.find(2, 0, 0);
+        store.erase(2, 0, 0);
+        EXPECT_EQ(Payload::live, 5);
+        EXPECT_EQ(store.find(2, 0, 0), nullptr);
+        store.erase(2, 0, 0);
+        EXPECT_EQ(store.size(), 5);
+
+        EXPECT_EQ(store.emplace(7, 7, 0, 7, 7, 0), p);
+        EXPECT_EQ(Payload::live, 6);
+    }
+    EXPECT_EQ(Payload::live, 0);
+}
+
+TEST(BlockStore, for_each_and_clear) {
+    Payload::live = 0;
+    BlockStore<Payload, 4> store(3, 3, 3);
+    store.emplace(2, 2, 2, 2, 2, 2);
+    store.emplace(0, 1, 0, 0, 1, 0);
+    store.emplace(1, 0, 2, 1, 0, 2);
+
+    std::vector<Payload*> seen;
+    store.for_each([&](Payload *p) { seen.push_back(p); });
+    ASSERT_EQ(seen.size(), 3);
+    EXPECT_EQ(seen[0]->z, 0);
+    EXPECT_EQ(seen[1]->x, 1);
+    EXPECT_EQ(seen[2]->x, 2);
+
+    store.clear();
+    EXPECT_EQ(Payload::live, 0);
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(store.find(2, 2, 2), nullptr);
+    EXPECT_NE(store.emplace(2, 2, 2, 2, 2, 2), nullptr);
+
+    store.resize(1, 1, 1);
+    EXPECT_EQ(Payload::live, 0);
+    EXPECT_FALSE(store.inBounds(2, 2, 2));
+}
@@ -66,6 +66,8 @@ distribution.
 #include "df/world_data.h"
 
 #include <stdio.h>
+#include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <stdlib.h>
 #include <fstream>
@@ -203,6 +205,165 @@ uint32_t PerfCounters::getUnpausedFps() {
     return num_frames / seconds;
 }
 
+uint64_t FrameProfiler::now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameProfiler::start(size_t capacity) {
+    reset();
+    events.assign(std::max<size_t>(capacity, 1), Event());
+    enabled = true;
+}
+
+void FrameProfiler::stop() {
+    enabled = false;
+}
+
+void FrameProfiler::reset() {
+    for (auto &event : events)
+        event = Event();
+    head = count = 0;
+    depth = 0;
+    frame = 0;
+    samples.clear();
+    epoch_us = now_us();
+}
+
+FrameProfiler::Scope::Scope(FrameProfiler &prof, const char *category, const char *name)
+    :profiler(prof.enabled ? &prof : NULL), category(category), name(name), slot(NO_SLOT), start_us(0)
+{
+    if (profiler) {
+        start_us = FrameProfiler::now_us();
+        ++profiler->depth;
+    }
+}
+
+FrameProfiler::Scope::Scope(FrameProfiler &prof, const char *category, const Plugin *plugin)
+    :Scope(prof, category, (const char *)NULL)
+{
+    slot = plugin->getPerfSlot();
+}
+
+FrameProfiler::Scope::Scope(FrameProfiler &prof, const char *category, const std::string &name)
+    :Scope(prof, category, (const char *)NULL)
+{
+    if (profiler)
+        this->name = profiler->names.insert(name).first->c_str();
+}
+
+FrameProfiler::Scope::~Scope() {
+    if (!profiler)
+        return;
+    if (profiler->depth > 0)
+        --profiler->depth;
+    // profiling may have been stopped while the scope was open
+    if (profiler->enabled)
+        profiler->record({category, name, slot}, start_us, FrameProfiler::now_us());
+}
+
+void FrameProfiler::record(const Key &key, uint64_t start_us, uint64_t end_us) {
+    uint32_t duration_us = uint32_t(std::min<uint64_t>(end_us - start_us, UINT32_MAX));
+
+    Event &event = events[head];
+    event.category = key.category;
+    event.name = key.name;
+    event.slot = key.slot;
+    event.start_us = start_us - std::min(start_us, epoch_us);
+    event.duration_us = duration_us;
+    event.frame = frame;
+    event.depth = depth;
+    head = (head + 1) % events.size();
+    count = std::min(count + 1, events.size());
+
+    Samples &s = samples[key];
+    if (s.window.empty())
+        s.window.resize(SAMPLE_WINDOW);
+    s.window[s.head] = duration_us;
+    s.head = (s.head + 1) % SAMPLE_WINDOW;
+    s.count++;
+    s.total_us += duration_us;
+    s.max_us = std::max(s.max_us, duration_us);
+}
+
+std::vector<std::string> FrameProfiler::pluginNames() {
+    std::vector<std::string> names;
+    auto plug_mgr = Core::getInstance().getPluginManager();
+    for (auto it = plug_mgr->begin(); it != plug_mgr->end(); ++it) {
+        size_t slot = it->second->getPerfSlot();
+        if (slot >= names.size())
+            names.resize(slot + 1);
+        names[slot] = it->first;
+    }
+    return names;
+}
+
+std::string FrameProfiler::scopeName(const char *name, size_t slot,
+                                     const std::vector<std::string> &plugin_names) {
+    if (name)
+        return name;
+    return slot < plugin_names.size() ? plugin_names[slot] : "<unknown plugin>";
+}
+
+void FrameProfiler::getStats(std::vector<Stats> *out) const {
+    auto plugin_names = pluginNames();
+    out->clear();
+    std::vector<uint32_t> sorted;
+    for (auto &entry : samples) {
+        const Samples &s = entry.second;
+        sorted.assign(s.window.begin(), s.window.begin() + std::min(s.count, SAMPLE_WINDOW));
+        std::sort(sorted.begin(), sorted.end());
+
+        Stats stats;
+        stats.category = entry.first.category;
+        stats.name = scopeName(entry.first.name, entry.first.slot, plugin_names);
+        stats.count = s.count;
+        stats.total_us = s.total_us;
+        stats.p50_us = sorted.empty() ? 0 : sorted[(sorted.size() - 1) / 2];
+        stats.p99_us = sorted.empty() ? 0 : sorted[(sorted.size() - 1) * 99 / 100];
+        stats.max_us = s.max_us;
+        out->push_back(stats);
+    }
+    std::sort(out->begin(), out->end(), [](const Stats &a, const Stats &b) {
+        return a.total_us > b.total_us;
+    });
+}
+
+static void write_json_string(std::ostream &out, const std::string &str) {
+    out << '"';
+    for (unsigned char c : str) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20 || c >= 0x80)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+bool FrameProfiler::exportChromeTrace(std::ostream &out) const {
+    auto plugin_names = pluginNames();
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    size_t start = (head + events.size() - count) % std::max<size_t>(events.size(), 1);
+    for (size_t i = 0; i < count; i++) {
+        const Event &event = events[(start + i) % events.size()];
+        if (i)
+            out << ',';
+        out << "\n{\"name\":";
+        write_json_string(out, scopeName(event.name, event.slot, plugin_names));
+        out << ",\"cat\":";
+        write_json_string(out, event.category);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+            << ",\"ts\":" << event.start_us
+            << ",\"dur\":" << event.duration_us
+            << ",\"args\":{\"frame\":" << event.frame
+            << ",\"depth\":" << event.depth << "}}";
+    }
+    out << "\n]}\n";
+    return out.good();
+}
+
 struct CommandDepthCounter
 {
     static const int MAX_DEPTH = 20;
@@ -1231,6 +1392,61 @@ command_result Core::runCommand(color_ostream &con, const std::string &first_, s
             return CR_WRONG_USAGE;
         }
     }
+    else if (first == "devel/profile")
+    {
+        CoreSuspender suspend;
+        std::string subcmd = parts.empty() ? "" : parts[0];
+        if (subcmd == "start")
+        {
+            size_t capacity = FrameProfiler::DEFAULT_CAPACITY;
+            if (parts.size() > 1)
+                capacity = std::max(1, atoi(parts[1].c_str()));
+            frame_profiler.start(capacity);
+            con.print("Profiling started; recording up to %zu scopes.\n", capacity);
+        }
+        else if (subcmd == "stop")
+        {
+            frame_profiler.stop();
+            con.print("Profiling stopped after %u frames.\n", frame_profiler.getFrameCount());
+        }
+        else if (subcmd == "reset")
+        {
+            frame_profiler.reset();
+        }
+        else if (subcmd == "report")
+        {
+            size_t limit = parts.size() > 1 ? std::max(1, atoi(parts[1].c_str())) : 25;
+            std::vector<FrameProfiler::Stats> stats;
+            frame_profiler.getStats(&stats);
+            con.print("%s %u frames, %zu scopes in buffer\n",
+                frame_profiler.isEnabled() ? "Profiling" : "Profiled",
+                frame_profiler.getFrameCount(), frame_profiler.getEventCount());
+            con.print("%-20s %-30s %9s %11s %8s %8s %8s\n",
+                "category", "name", "count", "total ms", "p50 us", "p99 us", "max us");
+            for (size_t i = 0; i < stats.size() && i < limit; i++)
+            {
+                auto &st = stats[i];
+                con.print("%-20s %-30s %9zu %11.3f %8u %8u %8u\n",
+                    st.category.c_str(), st.name.c_str(), st.count, st.total_us / 1000.0,
+                    st.p50_us, st.p99_us, st.max_us);
+            }
+        }
+        else if (subcmd == "export" && parts.size() == 2)
+        {
+            std::ofstream file(parts[1]);
+            if (!file || !frame_profiler.exportChromeTrace(file))
+            {
+                con.printerr("Could not write trace to %s\n", parts[1].c_str());
+                return CR_FAILURE;
+            }
+            con.print("Wrote %zu scopes to %s\n", frame_profiler.getEventCount(), parts[1].c_str());
+        }
+        else
+        {
+            con << "Usage: devel/profile start [<capacity>]|stop|reset|report [<count>]|export <filename>" << std::endl;
+            return CR_WRONG_USAGE;
+        }
+    }
     else if (first == "devel/dump-rpc")
     {
         if (parts.size() == 1)
@@ -1563,14 +1779,16 @@ bool Core::InitMainThread() {
     // find out what we are...
     #ifdef LINUX_BUILD
         const char * path = "hack/symbols.xml";
+        const char * cache_path = "hack/symbols.cache";
     #else
         const char * path = "hack\\symbols.xml";
+        const char * cache_path = "hack\\symbols.cache";
     #endif
     auto local_vif = std::make_unique<DFHack::VersionInfoFactory>();
     std::cerr << "Identifying DF version.\n";
     try
     {
-        local_vif->loadFile(path);
+        local_vif->loadFileCached(path, cache_path);
     }
     catch(Error::All & err)
     {
@@ -1985,6 +2203,9 @@ void Core::doUpdate(color_ostream &out)
     {
         plug_mgr->doSaveData(out);
         Persistence::Internal::save(out);
+        // DF may copy save/current into the region folder as soon as it
+        // gets control back, so our files have to be complete by then
+        Persistence::Internal::flush();
     }
 
     // detect if the game was loaded or unloaded in the meantime
@@ -2071,6 +2292,8 @@ int Core::Update()
 
         uint32_t start_ms = p->getTickCount();
         perf_counters.registerTick(start_ms);
+        frame_profiler.beginFrame();
+        FrameProfiler::Scope scope(frame_profiler, "core", "update");
         doUpdate(out);
         perf_counters.incCounter(perf_counters.total_update_ms, start_ms);
     }
@@ -2093,7 +2316,10 @@ void Core::onUpdate(color_ostream &out)
     Gui::clearFocusStringCache();
 
     uint32_t step_start_ms = p->getTickCount();
-    EventManager::manageEvents(out);
+    {
+        FrameProfiler::Scope scope(frame_profiler, "core", "event manager");
+        EventManager::manageEvents(out);
+    }
     perf_counters.incCounter(perf_counters.update_event_manager_ms, step_start_ms);
 
     // convert building reagents
@@ -2102,12 +2328,18 @@ void Core::onUpdate(color_ostream &out)
 
     // notify all the plugins that a game tick is finished
     step_start_ms = p->getTickCount();
-    plug_mgr->OnUpdate(out);
+    {
+        FrameProfiler::Scope scope(frame_profiler, "core", "plugin onUpdate");
+        plug_mgr->OnUpdate(out);
+    }
     perf_counters.incCounter(perf_counters.update_plugin_ms, step_start_ms);
 
     // process timers in lua
     step_start_ms = p->getTickCount();
-    Lua::Core::onUpdate(out);
+    {
+        FrameProfiler::Scope scope(frame_profiler, "core", "lua timers");
+        Lua::Core::onUpdate(out);
+    }
     perf_counters.incCounter(perf_counters.update_lua_ms, step_start_ms);
 }
 
@@ -2372,6 +2604,7 @@ int Core::Shutdown ( void )
     d->iothread.join();
 
     CoreSuspendClaimer suspend;
+    Persistence::Internal::flush();
     if(plug_mgr)
     {
         delete plug_mgr;
@@ -35,6 +35,7 @@ distribution.
 #include "DataDefs.h"
 #include "DataIdentity.h"
 #include "VTableInterpose.h"
+#include "VTableCache.h"
 #include "Error.h"
 
 #include "MiscUtils.h"
@@ -119,10 +120,20 @@ const std::string compound_identity::getFullName() const
 
 static std::mutex *known_mutex = NULL;
 
+/*
+ * Lock-free front for virtual_identity::known, probed by find(void*) before
+ * taking known_mutex. Only modified with known_mutex held. Entries of plugin
+ * classes are invalidated when the plugin is unloaded, which sends lookups
+ * back to the slow path.
+ */
+static VTableCache<virtual_identity> *vtable_cache = NULL;
+
 void compound_identity::Init(Core *core)
 {
     if (!known_mutex)
         known_mutex = new std::mutex();
+    if (!vtable_cache)
+        vtable_cache = new VTableCache<virtual_identity>();
 
     // This cannot be done in the constructors, because
     // they are called in an undefined order.
@@ -272,7 +283,11 @@ virtual_identity::~virtual_identity()
         name_lookup.erase(getOriginalName());
 
         if (vtable_ptr)
+        {
+            std::lock_guard<std::mutex> lock(*known_mutex);
             known.erase(vtable_ptr);
+            vtable_cache->invalidate(vtable_ptr);
+        }
     }
 }
 
@@ -285,7 +300,11 @@ void virtual_identity::doInit(Core *core)
 
     vtable_ptr = core->vinfo->getVTable(vtname);
     if (vtable_ptr)
+    {
+        std::lock_guard<std::mutex> lock(*known_mutex);
         known[vtable_ptr] = this;
+        vtable_cache->insert(vtable_ptr, this);
+    }
 }
 
 virtual_identity *virtual_identity::find(const std::string &name)
@@ -307,16 +326,21 @@ virtual_identity *virtual_identity::find(void *vtable)
     if (!vtable || !known_mutex)
         return NULL;
 
-    // Actually, a reader/writer lock would be sufficient,
-    // since the table is only written once per class.
+    virtual_identity *cached;
+    if (vtable_cache->find(vtable, &cached))
+        return cached;
+
+    // Slow path: first sighting of this vtable.
     std::lock_guard<std::mutex> lock(*known_mutex);
 
     std::map<void*, virtual_identity*>::iterator it = known.find(vtable);
 
     if (it != known.end())
+    {
+        vtable_cache->insert(vtable, it->second);
         return it->second;
+    }
 
-    // If using a reader/writer lock, re-grab as write here, and recheck
     Core &core = Core::getInstance();
     std::string name = core.p->doReadClassName(vtable);
 
@@ -337,6 +361,7 @@ virtual_identity *virtual_identity::find(void *vtable)
         }
 
         known[vtable] = p;
+        vtable_cache->insert(vtable, p);
         p->vtable_ptr = vtable;
         return p;
     }
@@ -347,6 +372,7 @@ virtual_identity *virtual_identity::find(void *vtable)
     }
 
     known[vtable] = NULL;
+    vtable_cache->insert(vtable, NULL);
     return NULL;
 }
 
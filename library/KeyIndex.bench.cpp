@@ -0,0 +1,60 @@
+#include "KeyIndex.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace DFHack;
+
+// Compares getAllByKey-style lookups on 100k entries against the
+// std::multimap of shared_ptrs that Persistence used before.
+TEST(KeyIndex, lookups_100k_entries) {
+    const int ENTRIES = 100000, KEYS = 1000, LOOKUPS = 10000;
+    typedef std::chrono::steady_clock clock;
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < KEYS; i++)
+        keys.push_back("plugin/config/" + std::to_string(i));
+
+    std::multimap<std::string, std::shared_ptr<int>> old_store;
+    KeyIndex<std::shared_ptr<int>> new_store;
+    for (int i = 0; i < ENTRIES; i++) {
+        auto value = std::make_shared<int>(i);
+        old_store.emplace(keys[i % KEYS], value);
+        new_store.add(keys[i % KEYS], value);
+    }
+
+    int64_t sum_old = 0, sum_new = 0;
+    auto t0 = clock::now();
+    {
+        std::vector<std::shared_ptr<int>> vec;
+        for (int i = 0; i < LOOKUPS; i++) {
+            vec.clear();
+            auto range = old_store.equal_range(keys[(i * 7) % KEYS]);
+            for (auto it = range.first; it != range.second; ++it)
+                vec.emplace_back(it->second);
+            for (auto &value : vec)
+                sum_old += *value;
+        }
+    }
+    auto t1 = clock::now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        new_store.for_each_key(keys[(i * 7) % KEYS], [&](const std::shared_ptr<int> &value) {
+            sum_new += *value;
+        });
+    }
+    auto t2 = clock::now();
+
+    EXPECT_EQ(sum_old, sum_new);
+
+    using std::chrono::microseconds;
+    using std::chrono::duration_cast;
+    std::cout << LOOKUPS << " key lookups over " << ENTRIES << " entries: std::multimap "
+              << duration_cast<microseconds>(t1 - t0).count() << " us, KeyIndex "
+              << duration_cast<microseconds>(t2 - t1).count() << " us" << std::endl;
+}
@@ -0,0 +1,80 @@
+#include "KeyIndex.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace DFHack;
+
+namespace {
+    std::vector<int> collect_key(const KeyIndex<int> &index, const std::string &key) {
+        std::vector<int> out;
+        index.for_each_key(key, [&](int val) { out.push_back(val); });
+        return out;
+    }
+}
+
+TEST(KeyIndex, add_find) {
+    KeyIndex<int> index;
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(index.find("a"), nullptr);
+
+    index.add("b", 1);
+    index.add("a", 2);
+    index.add("b", 3);
+    EXPECT_EQ(index.size(), 3);
+    ASSERT_NE(index.find("b"), nullptr);
+    EXPECT_EQ(*index.find("b"), 1);
+    EXPECT_EQ(index.count_key("b"), 2);
+    EXPECT_EQ(index.count_key("c"), 0);
+    EXPECT_EQ(collect_key(index, "b"), std::vector<int>({1, 3}));
+
+    std::vector<int> all;
+    index.for_each([&](int val) { all.push_back(val); });
+    EXPECT_EQ(all, std::vector<int>({2, 1, 3}));
+}
+
+TEST(KeyIndex, intern) {
+    KeyIndex<int> index;
+    const std::string &key = index.intern("plugin/key");
+    EXPECT_EQ(&index.intern(std::string("plugin/") + "key"), &key);
+    index.add("plugin/key", 1);
+    index.erase_if("plugin/key", [](int) { return true; });
+    EXPECT_EQ(key, "plugin/key");
+}
+
+TEST(KeyIndex, erase_if) {
+    KeyIndex<int> index;
+    index.add("k", 1);
+    index.add("k", 2);
+    index.add("k", 3);
+    EXPECT_FALSE(index.erase_if("x", [](int) { return true; }));
+    EXPECT_FALSE(index.erase_if("k", [](int val) { return val == 4; }));
+    EXPECT_TRUE(index.erase_if("k", [](int val) { return val == 2; }));
+    EXPECT_EQ(collect_key(index, "k"), std::vector<int>({1, 3}));
+    EXPECT_TRUE(index.erase_if("k", [](int) { return true; }));
+    EXPECT_TRUE(index.erase_if("k", [](int) { return true; }));
+    EXPECT_EQ(index.find("k"), nullptr);
+    EXPECT_TRUE(index.empty());
+}
+
+TEST(KeyIndex, for_each_range) {
+    KeyIndex<int> index;
+    index.add("a", 1);
+    index.add("ab", 2);
+    index.add("abc", 3);
+    index.add("b", 4);
+
+    auto range = [&](const std::string &min, const std::string &max) {
+        std::vector<int> out;
+        index.for_each_range(min, max, [&](int val) { out.push_back(val); });
+        return out;
+    };
+    EXPECT_EQ(range("a", "b"), std::vector<int>({1, 2, 3}));
+    EXPECT_EQ(range("ab", "ac"), std::vector<int>({2, 3}));
+    EXPECT_EQ(range("a", "z"), std::vector<int>({1, 2, 3, 4}));
+    EXPECT_EQ(range("c", "z"), std::vector<int>());
+    EXPECT_EQ(range("b", "a"), std::vector<int>());
+    EXPECT_EQ(range("0", "1"), std::vector<int>());
+}
@@ -290,7 +290,7 @@ static int dfhack_persistent_get_data_string(lua_State *L, get_data_fn get_data)
     if (!data.isValid())
         lua_pushnil(L);
     else
-        Lua::Push(L, data.val());
+        Lua::Push(L, data.get_str());
 
     return 1;
 }
@@ -311,7 +311,7 @@ static int dfhack_persistent_save_data_string(lua_State *L, raw_get_data_fn get_
     if (!data.isValid())
         luaL_error(L, "unable to save data in key '%s'", key);
 
-    data.val() = str;
+    data.set_str(str);
 
     return 0;
 }
@@ -4131,6 +4131,17 @@ static std::map<const char *, std::map<string, uint32_t>> mapify(std::map<const
     return out_map;
 }
 
+static std::unordered_map<std::string, uint32_t> name_plugin_counters(const std::vector<uint32_t> &counters) {
+    std::unordered_map<std::string, uint32_t> out_map;
+    auto plug_mgr = Core::getInstance().getPluginManager();
+    for (auto it = plug_mgr->begin(); it != plug_mgr->end(); ++it) {
+        size_t slot = it->second->getPerfSlot();
+        if (slot < counters.size())
+            out_map[it->first] = counters[slot];
+    }
+    return out_map;
+}
+
 static int internal_getPerfCounters(lua_State *L) {
     auto & core = Core::getInstance();
     auto & counters = core.perf_counters;
@@ -4154,14 +4165,38 @@ static int internal_getPerfCounters(lua_State *L) {
     Lua::Push(L, summary);
     Lua::Push(L, translate_event_types(counters.event_manager_event_total_ms));
     Lua::Push(L, mapify(translate_event_types(counters.event_manager_event_per_plugin_ms)));
-    Lua::Push(L, counters.update_per_plugin);
-    Lua::Push(L, counters.state_change_per_plugin);
+    Lua::Push(L, name_plugin_counters(counters.update_per_plugin));
+    Lua::Push(L, name_plugin_counters(counters.state_change_per_plugin));
     Lua::Push(L, counters.update_lua_per_repeat);
     Lua::Push(L, counters.overlay_per_widget);
     Lua::Push(L, counters.zscreen_per_focus);
     return 8;
 }
 
+static int internal_setEventManagerBudget(lua_State *L) {
+    uint32_t budget_ms = luaL_checkinteger(L, 1);
+    int32_t max_delay_ticks = luaL_optinteger(L, 2, 10);
+    EventManager::setFrameBudget(budget_ms, max_delay_ticks);
+    return 0;
+}
+
+static int internal_getEventManagerBudget(lua_State *L) {
+    Lua::Push(L, EventManager::getFrameBudget());
+    Lua::Push(L, EventManager::getMaxDelayTicks());
+    return 2;
+}
+
+static int internal_setEventManagerInventoryShards(lua_State *L) {
+    lua_Integer shards = luaL_checkinteger(L, 1);
+    EventManager::setInventoryShards(size_t(std::max<lua_Integer>(1, shards)));
+    return 0;
+}
+
+static int internal_getEventManagerInventoryShards(lua_State *L) {
+    Lua::Push(L, EventManager::getInventoryShards());
+    return 1;
+}
+
 static int internal_getClipboardTextCp437Multiline(lua_State *L) {
     vector<string> lines;
     getClipboardTextCp437Multiline(&lines);
@@ -4202,6 +4237,10 @@ static const luaL_Reg dfhack_internal_funcs[] = {
     { "setMortalMode", internal_setMortalMode },
     { "setArmokTools", internal_setArmokTools },
     { "getPerfCounters", internal_getPerfCounters },
+    { "setEventManagerBudget", internal_setEventManagerBudget },
+    { "getEventManagerBudget", internal_getEventManagerBudget },
+    { "setEventManagerInventoryShards", internal_setEventManagerInventoryShards },
+    { "getEventManagerInventoryShards", internal_getEventManagerInventoryShards },
     { "getPreferredNumberFormat", internal_getPreferredNumberFormat },
     { "getClipboardTextCp437Multiline", internal_getClipboardTextCp437Multiline },
     { NULL, NULL }
@@ -63,8 +63,10 @@ distribution.
 #include <lualib.h>
 #include <lstate.h>
 
+#include <algorithm>
 #include <csignal>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
@@ -1940,10 +1942,164 @@ lua_State *DFHack::Lua::Open(color_ostream &out, lua_State *state)
     return state;
 }
 
+namespace {
+    /*
+     * Hierarchical timing wheel for timeout ids. Four levels of 256 slots
+     * each cover the whole 32-bit time range; a timer lives in the lowest
+     * level whose higher time bits agree with the current time, and is
+     * cascaded down as time advances. Scheduling and cancelling are O(1).
+     */
+    class TimerWheel {
+    public:
+        bool empty() const { return timers.empty(); }
+
+        void schedule(int id, int due, int now, std::string name) {
+            if (timers.empty())
+                current = uint32_t(now);
+            // delta is always positive, but guard against time going backwards
+            uint32_t when = std::max(uint32_t(due), current + 1);
+            auto &timer = timers[id];
+            timer.due = when;
+            timer.name = std::move(name);
+            place(id, timer);
+        }
+
+        bool cancel(int id) {
+            auto it = timers.find(id);
+            if (it == timers.end())
+                return false;
+            unplace(it->second);
+            timers.erase(it);
+            return true;
+        }
+
+        std::vector<int> ids() const {
+            std::vector<int> ret;
+            for (auto &entry : timers)
+                ret.push_back(entry.first);
+            return ret;
+        }
+
+        void clear() {
+            for (auto &level : slots)
+                for (auto &slot : level)
+                    slot.clear();
+            timers.clear();
+        }
+
+        // Advance time to bound, appending every timer that became due to
+        // out in due time order, then id order.
+        void advance(int bound, std::vector<std::pair<int, std::string>> *out) {
+            uint32_t target = uint32_t(bound);
+            if (timers.empty() || int32_t(target - current) <= 0) {
+                if (timers.empty())
+                    current = target;
+                return;
+            }
+
+            if (target - current > SLOTS) {
+                rebase(target, out);
+                return;
+            }
+
+            std::vector<int> batch;
+            while (current != target) {
+                current++;
+                cascade();
+                auto &slot = slots[0][current & MASK];
+                if (slot.empty())
+                    continue;
+                batch.assign(slot.begin(), slot.end());
+                slot.clear();
+                std::sort(batch.begin(), batch.end());
+                for (int id : batch) {
+                    auto it = timers.find(id);
+                    out->emplace_back(id, std::move(it->second.name));
+                    timers.erase(it);
+                }
+            }
+        }
+
+    private:
+        static const int BITS = 8;
+        static const uint32_t SLOTS = 1 << BITS;
+        static const uint32_t MASK = SLOTS - 1;
+        static const int LEVELS = 4;
+
+        struct Timer {
+            uint32_t due;
+            uint8_t level;
+            uint8_t slot;
+            uint32_t pos;
+            std::string name;
+        };
+
+        uint32_t current = 0;
+        std::vector<int> slots[LEVELS][SLOTS];
+        std::unordered_map<int, Timer> timers;
+
+        void place(int id, Timer &timer) {
+            int level = 0;
+            while (level < LEVELS - 1 && (timer.due >> (BITS * (level + 1))) != (current >> (BITS * (level + 1))))
+                level++;
+            auto &slot = slots[level][(timer.due >> (BITS * level)) & MASK];
+            timer.level = level;
+            timer.slot = (timer.due >> (BITS * level)) & MASK;
+            timer.pos = slot.size();
+            slot.push_back(id);
+        }
+
+        void unplace(const Timer &timer) {
+            auto &slot = slots[timer.level][timer.slot];
+            int moved = slot.back();
+            slot[timer.pos] = moved;
+            slot.pop_back();
+            if (timer.pos < slot.size())
+                timers[moved].pos = timer.pos;
+        }
+
+        // When the lower bits of the time wrap around, redistribute the
+        // timers of the higher level slot that just became current.
+        void cascade() {
+            for (int level = 1; level < LEVELS; level++) {
+                if ((current >> (BITS * (level - 1))) & MASK)
+                    break;
+                std::vector<int> moved;
+                moved.swap(slots[level][(current >> (BITS * level)) & MASK]);
+                for (int id : moved)
+                    place(id, timers[id]);
+            }
+        }
+
+        // Used when time jumps far ahead (e.g. a save was loaded); collect
+        // all due timers directly and rebuild the wheel around the new time.
+        void rebase(uint32_t target, std::vector<std::pair<int, std::string>> *out) {
+            std::vector<std::pair<uint32_t, int>> due;
+            for (auto &entry : timers) {
+                if (int32_t(entry.second.due - target) <= 0)
+                    due.emplace_back(entry.second.due, entry.first);
+            }
+            std::sort(due.begin(), due.end());
+            for (auto &entry : due) {
+                auto it = timers.find(entry.second);
+                out->emplace_back(entry.second, std::move(it->second.name));
+                timers.erase(it);
+            }
+
+            for (auto &level : slots)
+                for (auto &slot : level)
+                    slot.clear();
+            current = target;
+            for (auto &entry : timers)
+                place(entry.first, entry.second);
+        }
+    };
+}
+
 static int next_timeout_id = 0;
 static int frame_idx = 0;
-static std::multimap<int,int> frame_timers;
-static std::multimap<int,int> tick_timers;
+static TimerWheel frame_timers;
+static TimerWheel tick_timers;
 
 int DFHACK_TIMEOUTS_TOKEN = 0;
 
@@ -1960,6 +2116,7 @@ int dfhack_timeout(lua_State *L)
     lua_Number time = luaL_checknumber(L, 1);
     int mode = luaL_checkoption(L, 2, NULL, timeout_modes);
     luaL_checktype(L, 3, LUA_TFUNCTION);
+    std::string name = luaL_optstring(L, 4, "");
     lua_settop(L, 3);
 
     if (mode > 0 && !Core::getInstance().isWorldLoaded())
@@ -1991,9 +2148,9 @@ int dfhack_timeout(lua_State *L)
     // Queue the timeout
     int id = next_timeout_id++;
     if (mode)
-        tick_timers.insert(std::pair<int,int>(world->frame_counter+delta, id));
+        tick_timers.schedule(id, world->frame_counter+delta, world->frame_counter, name);
     else
-        frame_timers.insert(std::pair<int,int>(frame_idx+delta, id));
+        frame_timers.schedule(id, frame_idx+delta, frame_idx, name);
 
     lua_rawgetp(L, LUA_REGISTRYINDEX, &DFHACK_TIMEOUTS_TOKEN);
     lua_swap(L);
@@ -2023,21 +2180,23 @@ int dfhack_timeout_active(lua_State *L)
     {
         lua_pushvalue(L, 2);
         lua_rawseti(L, 3, id);
+        if (lua_isnil(L, 2) && !frame_timers.cancel(id))
+            tick_timers.cancel(id);
     }
     return 1;
 }
 
-static void cancel_timers(std::multimap<int,int> &timers)
+static void cancel_timers(TimerWheel &timers)
 {
     using Lua::Core::State;
 
     Lua::StackUnwinder frame(State);
     lua_rawgetp(State, LUA_REGISTRYINDEX, &DFHACK_TIMEOUTS_TOKEN);
 
-    for (auto it = timers.begin(); it != timers.end(); ++it)
+    for (int id : timers.ids())
     {
         lua_pushnil(State);
-        lua_rawseti(State, frame[1], it->second);
+        lua_rawseti(State, frame[1], id);
     }
 
     timers.clear();
@@ -2061,24 +2220,39 @@ void DFHack::Lua::Core::onStateChange(color_ostream &out, int code) {
 }
 
 static void run_timers(color_ostream &out, lua_State *L,
-                       std::multimap<int,int> &timers, int table, int bound)
+                       TimerWheel &timers, int table, int bound)
 {
-    while (!timers.empty() && timers.begin()->first <= bound)
-    {
-        int id = timers.begin()->second;
-        timers.erase(timers.begin());
+    std::vector<std::pair<int, std::string>> due;
+    timers.advance(bound, &due);
 
+    auto &core = DFHack::Core::getInstance();
+    auto &counters = core.perf_counters;
+
+    for (auto &timer : due)
+    {
+        int id = timer.first;
         lua_rawgeti(L, table, id);
 
         if (lua_isnil(L, -1))
-            lua_pop(L, 1);
-        else
         {
-            lua_pushnil(L);
-            lua_rawseti(L, table, id);
+            lua_pop(L, 1);
+            continue;
+        }
+
+        lua_pushnil(L);
+        lua_rawseti(L, table, id);
 
+        // Attribute the runtime to the name passed to dfhack.timeout.
+        // Unnamed timers share one counter, so they cost no lookups here.
+        static const std::string unnamed = "(unnamed)";
+        const std::string &name = timer.second.empty() ? unnamed : timer.second;
+
+        uint32_t start_ms = core.p->getTickCount();
+        {
+            FrameProfiler::Scope scope(core.frame_profiler, "lua timer", name);
             Lua::SafeCall(out, L, 0, 0);
         }
+        counters.incCounter(counters.update_lua_per_repeat[name], start_ms);
     }
 }
 
@@ -2086,13 +2260,14 @@ void DFHack::Lua::Core::onUpdate(color_ostream &out)
 {
     using df::global::world;
 
+    ++frame_idx;
     if (frame_timers.empty() && tick_timers.empty())
         return;
 
     Lua::StackUnwinder frame(State);
     lua_rawgetp(State, LUA_REGISTRYINDEX, &DFHACK_TIMEOUTS_TOKEN);
 
-    run_timers(out, State, frame_timers, frame[1], ++frame_idx);
+    run_timers(out, State, frame_timers, frame[1], frame_idx);
 
     if (world)
         run_timers(out, State, tick_timers, frame[1], world->frame_counter);
@@ -24,7 +24,11 @@ distribution.
 
 #include "Internal.h"
 
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <map>
 
@@ -605,6 +609,336 @@ static void write_field(lua_State *state, const struct_field_info *field, void *
     }
 }
 
+/*
+ * Compiled field accessors. For each (structure, field) pair that is
+ * accessed from Lua, remember the primitive storage type of the field so
+ * that numbers and booleans can be read and written directly at the field
+ * offset, and the resolved union tag field, which otherwise requires a
+ * search by name through the structure and its parents.
+ *
+ * Accessors are immutable once created and never freed; lookups go through
+ * a lock-free direct-mapped table of pointers to them.
+ */
+namespace {
+    enum class FieldKind : uint8_t {
+        GENERIC,
+        INT8, UINT8, INT16, UINT16, INT32, UINT32, INT64, UINT64,
+        FLOAT, DOUBLE, BOOL
+    };
+
+    struct FieldAccessor {
+        const struct_identity *structure;
+        const struct_field_info *field;
+        FieldKind kind;
+        const struct_field_info *union_tag;
+    };
+
+    template<typename T>
+    FieldKind integer_kind() {
+        static_assert(sizeof(T) <= 8, "unsupported integer size");
+        bool is_signed = std::is_signed<T>::value;
+        switch (sizeof(T)) {
+        case 1: return is_signed ? FieldKind::INT8 : FieldKind::UINT8;
+        case 2: return is_signed ? FieldKind::INT16 : FieldKind::UINT16;
+        case 4: return is_signed ? FieldKind::INT32 : FieldKind::UINT32;
+        default: return is_signed ? FieldKind::INT64 : FieldKind::UINT64;
+        }
+    }
+
+    template<typename T>
+    bool match_integer(const type_identity *type, FieldKind *kind) {
+        if (type != df::identity_traits<T>::get())
+            return false;
+        *kind = integer_kind<T>();
+        return true;
+    }
+
+    FieldKind classify_field(const struct_field_info *field) {
+        if (field->mode != struct_field_info::PRIMITIVE || !field->type)
+            return FieldKind::GENERIC;
+
+        const type_identity *type = field->type;
+        if (type->type() == IDTYPE_ENUM)
+            type = static_cast<const enum_identity*>(type)->getBaseType();
+
+        FieldKind kind = FieldKind::GENERIC;
+        if (match_integer<char>(type, &kind) ||
+            match_integer<signed char>(type, &kind) ||
+            match_integer<unsigned char>(type, &kind) ||
+            match_integer<short>(type, &kind) ||
+            match_integer<unsigned short>(type, &kind) ||
+            match_integer<int>(type, &kind) ||
+            match_integer<unsigned int>(type, &kind) ||
+            match_integer<long>(type, &kind) ||
+            match_integer<unsigned long>(type, &kind) ||
+            match_integer<long long>(type, &kind) ||
+            match_integer<unsigned long long>(type, &kind))
+            return kind;
+        if (type == df::identity_traits<float>::get())
+            return FieldKind::FLOAT;
+        if (type == df::identity_traits<double>::get())
+            return FieldKind::DOUBLE;
+        if (type == df::identity_traits<bool>::get())
+            return FieldKind::BOOL;
+        return FieldKind::GENERIC;
+    }
+
+    class FieldAccessorCache {
+        static const size_t SIZE = 4096; // power of two
+
+        std::atomic<const FieldAccessor*> slots[SIZE];
+        std::mutex mutex;
+        std::map<std::pair<const void*, const void*>, const FieldAccessor*> known;
+        std::deque<FieldAccessor> storage;
+
+        static size_t hash(const void *structure, const void *field) {
+            uint64_t v = (uint64_t(uintptr_t(field)) >> 3) ^ (uint64_t(uintptr_t(structure)) >> 2);
+            return size_t((v * 0x9E3779B97F4A7C15ULL) >> 40) & (SIZE - 1);
+        }
+
+    public:
+        FieldAccessorCache() {
+            for (auto &slot : slots)
+                slot.store(nullptr, std::memory_order_relaxed);
+        }
+
+        // structure may be NULL if the union tag is not needed
+        const FieldAccessor *get(const struct_identity *structure, const struct_field_info *field) {
+            auto &slot = slots[hash(structure, field)];
+            auto acc = slot.load(std::memory_order_acquire);
+            if (acc && acc->field == field && acc->structure == structure)
+                return acc;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &entry = known[std::make_pair((const void*)structure, (const void*)field)];
+            if (!entry) {
+                FieldAccessor info;
+                info.structure = structure;
+                info.field = field;
+                info.kind = classify_field(field);
+                info.union_tag = structure ? find_union_tag(structure, field) : NULL;
+                storage.push_back(info);
+                entry = &storage.back();
+            }
+            slot.store(entry, std::memory_order_release);
+            return entry;
+        }
+    };
+
+    FieldAccessorCache field_accessors;
+}
+
+// Returns false if the field needs the generic read path.
+static inline bool fast_read_field(lua_State *state, const FieldAccessor *acc, void *ptr)
+{
+    switch (acc->kind)
+    {
+    case FieldKind::INT8: lua_pushinteger(state, *(int8_t*)ptr); return true;
+    case FieldKind::UINT8: lua_pushinteger(state, *(uint8_t*)ptr); return true;
+    case FieldKind::INT16: lua_pushinteger(state, *(int16_t*)ptr); return true;
+    case FieldKind::UINT16: lua_pushinteger(state, *(uint16_t*)ptr); return true;
+    case FieldKind::INT32: lua_pushinteger(state, *(int32_t*)ptr); return true;
+    case FieldKind::UINT32: lua_pushinteger(state, *(uint32_t*)ptr); return true;
+    case FieldKind::INT64: lua_pushinteger(state, *(int64_t*)ptr); return true;
+    case FieldKind::UINT64: lua_pushinteger(state, int64_t(*(uint64_t*)ptr)); return true;
+    case FieldKind::FLOAT: lua_pushnumber(state, *(float*)ptr); return true;
+    case FieldKind::DOUBLE: lua_pushnumber(state, *(double*)ptr); return true;
+    case FieldKind::BOOL: lua_pushboolean(state, *(bool*)ptr); return true;
+    case FieldKind::GENERIC: break;
+    }
+    return false;
+}
+
+// Returns false if the field (or value) needs the generic write path,
+// which also produces the appropriate error messages.
+static inline bool fast_write_field(lua_State *state, const FieldAccessor *acc, void *ptr, int value_idx)
+{
+    int is_num = 0;
+    switch (acc->kind)
+    {
+    case FieldKind::GENERIC:
+    case FieldKind::BOOL:
+        return false;
+    case FieldKind::FLOAT:
+    case FieldKind::DOUBLE:
+    {
+        lua_Number value = lua_tonumberx(state, value_idx, &is_num);
+        if (!is_num)
+            return false;
+        if (acc->kind == FieldKind::FLOAT)
+            *(float*)ptr = float(value);
+        else
+            *(double*)ptr = value;
+        return true;
+    }
+    default:
+        break;
+    }
+
+    int64_t value = lua_tointegerx(state, value_idx, &is_num);
+    if (!is_num)
+        return false;
+    switch (acc->kind)
+    {
+    case FieldKind::INT8: *(int8_t*)ptr = int8_t(value); break;
+    case FieldKind::UINT8: *(uint8_t*)ptr = uint8_t(value); break;
+    case FieldKind::INT16: *(int16_t*)ptr = int16_t(value); break;
+    case FieldKind::UINT16: *(uint16_t*)ptr = uint16_t(value); break;
+    case FieldKind::INT32: *(int32_t*)ptr = int32_t(value); break;
+    case FieldKind::UINT32: *(uint32_t*)ptr = uint32_t(value); break;
+    case FieldKind::INT64: *(int64_t*)ptr = value; break;
+    case FieldKind::UINT64: *(uint64_t*)ptr = uint64_t(value); break;
+    default: return false;
+    }
+    return true;
+}
+
+/*
+ * Bulk extraction of primitive fields from all items of a container.
+ */
+namespace {
+    struct ExtractColumn {
+        size_t offset;
+        const FieldAccessor *acc;
+    };
+
+    const struct_field_info *find_struct_field(const struct_identity *type, const std::string &name)
+    {
+        for (; type; type = type->getParent())
+        {
+            auto fields = type->getFields();
+            if (!fields)
+                continue;
+            for (int i = 0; fields[i].mode != struct_field_info::END; i++)
+            {
+                if (fields[i].name && name == fields[i].name)
+                    return &fields[i];
+            }
+        }
+        return NULL;
+    }
+
+    // Resolves a dotted path like "pos.x" through embedded substructures.
+    bool resolve_column(const struct_identity *type, const std::string &path,
+                        ExtractColumn *col, std::string *err)
+    {
+        col->offset = 0;
+        size_t start = 0;
+        for (;;)
+        {
+            size_t dot = path.find('.', start);
+            std::string name = path.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+            auto field = find_struct_field(type, name);
+            if (!field)
+            {
+                *err = "field not found: " + name;
+                return false;
+            }
+            col->offset += field->offset;
+
+            if (dot == std::string::npos)
+            {
+                col->acc = field_accessors.get(NULL, field);
+                if (col->acc->kind == FieldKind::GENERIC)
+                {
+                    *err = "not a primitive field: " + path;
+                    return false;
+                }
+                return true;
+            }
+
+            if (field->mode != struct_field_info::SUBSTRUCT || !field->type ||
+                (field->type->type() != IDTYPE_STRUCT && field->type->type() != IDTYPE_CLASS))
+            {
+                *err = "not a substructure: " + name;
+                return false;
+            }
+            type = static_cast<const struct_identity*>(field->type);
+            start = dot + 1;
+        }
+    }
+}
+
+/**
+ * Function: df.extract(container, fields)
+ *
+ * Copies the listed primitive fields of every structure in the container
+ * into a table of plain Lua arrays, keyed by field name. NULL items of
+ * pointer vectors are skipped. Also returns the number of rows.
+ */
+int LuaWrapper::bulk_extract(lua_State *state)
+{
+    luaL_checktype(state, 2, LUA_TTABLE);
+
+    auto id = get_object_identity(state, 1, "df.extract()", false, false);
+    if (!id->isContainer())
+        luaL_argerror(state, 1, "container expected");
+    auto cid = static_cast<const container_identity*>(id);
+
+    const type_identity *item = cid->getItemType();
+    bool indirect = (id->type() == IDTYPE_PTR_CONTAINER || id->type() == IDTYPE_STL_PTR_VECTOR);
+    if (item && !indirect && item->type() == IDTYPE_POINTER)
+    {
+        item = static_cast<const pointer_identity*>(item)->getTarget();
+        indirect = true;
+    }
+    if (!item || (item->type() != IDTYPE_STRUCT && item->type() != IDTYPE_CLASS))
+        luaL_argerror(state, 1, "container of structures expected");
+    auto stype = static_cast<const struct_identity*>(item);
+
+    std::vector<ExtractColumn> columns;
+    int ncols = (int)lua_rawlen(state, 2);
+    for (int i = 1; i <= ncols; i++)
+    {
+        lua_rawgeti(state, 2, i);
+        const char *path = lua_tostring(state, -1);
+        if (!path)
+            luaL_argerror(state, 2, "field names expected");
+        ExtractColumn col;
+        std::string err;
+        if (!resolve_column(stype, path, &col, &err))
+            luaL_argerror(state, 2, err.c_str());
+        columns.push_back(col);
+        lua_pop(state, 1);
+    }
+
+    void *ptr = get_object_ref(state, 1);
+    int count = cid->getItemCount(ptr);
+
+    luaL_checkstack(state, ncols + 2, "too many fields in df.extract()");
+    lua_createtable(state, 0, ncols);
+    int base = lua_gettop(state);
+    for (int i = 0; i < ncols; i++)
+        lua_createtable(state, count, 0);
+
+    int rows = 0;
+    for (int i = 0; i < count; i++)
+    {
+        auto pitem = (uint8_t*)cid->getItemPointer(ptr, i);
+        if (indirect)
+            pitem = *(uint8_t**)pitem;
+        if (!pitem)
+            continue;
+
+        rows++;
+        for (int j = 0; j < ncols; j++)
+        {
+            fast_read_field(state, columns[j].acc, pitem + columns[j].offset);
+            lua_rawseti(state, base + 1 + j, rows);
+        }
+    }
+
+    for (int j = ncols; j > 0; j--)
+    {
+        lua_rawgeti(state, 2, j);
+        lua_insert(state, -2);
+        lua_rawset(state, base);
+    }
+
+    lua_pushinteger(state, rows);
+    return 2;
+}
+
 /**
  * Metamethod: __index for structures.
  */
@@ -614,11 +948,14 @@ static int meta_struct_index(lua_State *state)
     auto field = (struct_field_info*)find_field(state, 2, "read");
     if (!field)
         return 1;
+    if (field->mode == struct_field_info::PRIMITIVE &&
+        fast_read_field(state, field_accessors.get(NULL, field), ptr + field->offset))
+        return 1;
     read_field(state, field, ptr + field->offset);
     if (field->mode == struct_field_info::SUBSTRUCT || field->mode == struct_field_info::CONTAINER)
     {
         auto struct_type = (struct_identity*)get_object_identity(state, 1, "read", false);
-        if (auto tag_field = find_union_tag(struct_type, field))
+        if (auto tag_field = field_accessors.get(struct_type, field)->union_tag)
         {
             get_object_ref_header(state, -1)->tag_ptr = ptr + tag_field->offset;
             get_object_ref_header(state, -1)->tag_identity = tag_field->type;
@@ -643,7 +980,7 @@ static int meta_struct_field_reference(lua_State *state)
     if (field->mode == struct_field_info::SUBSTRUCT || field->mode == struct_field_info::CONTAINER)
     {
         auto struct_type = (struct_identity*)get_object_identity(state, 1, "reference", false);
-        if (auto tag_field = find_union_tag(struct_type, field))
+        if (auto tag_field = field_accessors.get(struct_type, field)->union_tag)
         {
             get_object_ref_header(state, -1)->tag_ptr = ptr + tag_field->offset;
             get_object_ref_header(state, -1)->tag_identity = tag_field->type;
@@ -679,6 +1016,9 @@ static int meta_struct_newindex(lua_State *state)
     auto field = (struct_field_info*)find_field(state, 2, "write");
     if (!field)
         field_error(state, 2, "builtin property or method", "write");
+    if (field->mode == struct_field_info::PRIMITIVE &&
+        fast_write_field(state, field_accessors.get(NULL, field), ptr + field->offset, 3))
+        return 0;
     write_field(state, field, ptr + field->offset, 3);
     return 0;
 }
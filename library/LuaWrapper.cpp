@@ -1822,6 +1822,9 @@ static int DoAttach(lua_State *state)
         lua_pushcfunction(state, meta_isnull);
         lua_setfield(state, -2, "isnull");
 
+        lua_pushcfunction(state, bulk_extract);
+        lua_setfield(state, -2, "extract");
+
         freeze_table(state, true, "df");
 
         // pairstable dftable dfmeta
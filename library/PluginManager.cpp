@@ -44,8 +44,14 @@ distribution.
 
 using namespace DFHack;
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <map>
 using namespace std;
@@ -181,6 +187,7 @@ Plugin::Plugin(Core * core, const std::string & path,
      name(name),
      parent(pm)
 {
+    perf_slot = 0;
     plugin_lib = 0;
     plugin_init = 0;
     plugin_globals = 0;
@@ -228,25 +235,48 @@ const char *Plugin::getStateDescription (plugin_state state)
 
 bool Plugin::load(color_ostream &con)
 {
-    {
-        RefAutolock lock(access);
-        if(state == PS_LOADED)
-        {
-            return true;
-        }
-        else if(state != PS_UNLOADED && state != PS_DELETED)
-        {
-            if (state == PS_BROKEN)
-                con.printerr("Plugin %s is broken - cannot be loaded\n", name.c_str());
-            return false;
-        }
-        state = PS_LOADING;
-    }
+    if (!begin_load(con))
+        return getState() == PS_LOADED;
     // enter suspend
     CoreSuspender suspend;
+    return open_library(con) && init_library(con);
+}
+
+bool Plugin::begin_load(color_ostream &con)
+{
+    RefAutolock lock(access);
+    if(state == PS_LOADED)
+    {
+        return false;
+    }
+    else if(state != PS_UNLOADED && state != PS_DELETED)
+    {
+        if (state == PS_BROKEN)
+            con.printerr("Plugin %s is broken - cannot be loaded\n", name.c_str());
+        return false;
+    }
+    state = PS_LOADING;
+    return true;
+}
+
+// Opening and closing a library runs its static constructors and
+// destructors, and those register struct and compound identities in global
+// lists that are not synchronized. Only one library is opened or closed at a
+// time for that reason.
+static std::mutex library_mutex;
+
+// Does not touch Lua or call plugin_init, so it may run on a worker thread;
+// see PluginManager::loadAllParallel. Only the symbol lookups and version
+// checks actually run in parallel, since OpenPlugin holds library_mutex.
+bool Plugin::open_library(color_ostream &con)
+{
     // open the library, etc
     fprintf(stderr, "loading plugin %s\n", name.c_str());
-    DFLibrary * plug = OpenPlugin(path.c_str());
+    DFLibrary * plug;
+    {
+        std::lock_guard<std::mutex> lib_lock(library_mutex);
+        plug = OpenPlugin(path.c_str());
+    }
     if(!plug)
     {
         RefAutolock lock(access);
@@ -262,7 +292,7 @@ bool Plugin::load(color_ostream &con)
             return false;
         }
     }
-    #define plugin_abort_load ClosePlugin(plug); RefAutolock lock(access); state = PS_UNLOADED
+    #define plugin_abort_load { std::lock_guard<std::mutex> lib_lock(library_mutex); ClosePlugin(plug); } RefAutolock lock(access); state = PS_UNLOADED
     #define plugin_check_symbol(sym) \
         if (!LookupPlugin(plug, sym)) \
         { \
@@ -354,14 +384,23 @@ bool Plugin::load(color_ostream &con)
     plugin_save_site_data = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_save_site_data");
     plugin_load_world_data = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_load_world_data");
     plugin_load_site_data = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_load_site_data");
-    index_lua(plug);
     plugin_lib = plug;
+    return true;
+}
+
+bool Plugin::init_library(color_ostream &con)
+{
+    DFLibrary *plug = plugin_lib;
+    const char ** plug_git_desc_ptr = (const char**) LookupPlugin(plug, "plugin_git_description");
+    const char *plug_git_desc = plug_git_desc_ptr ? *plug_git_desc_ptr : "unknown";
+    index_lua(plug);
     commands.clear();
     if (plugin_init(con, commands) == CR_OK)
     {
         RefAutolock lock(access);
         state = PS_LOADED;
         parent->registerCommands(this);
+        parent->addDispatch(this);
         if ((plugin_onupdate || plugin_enable) && !plugin_is_enabled)
             con.printerr("Plugin %s has no enabled var!\n", name.c_str());
         if (Core::getInstance().isWorldLoaded() && plugin_load_world_data && plugin_load_world_data(con) != CR_OK)
@@ -412,6 +451,7 @@ bool Plugin::unload(color_ostream &con)
         // enter suspend
         CoreSuspender suspend;
         access->lock();
+        parent->removeDispatch(this);
         if (Core::getInstance().isMapLoaded() && plugin_save_site_data && World::IsSiteLoaded() && plugin_save_site_data(con) != CR_OK)
             con.printerr("Plugin %s has failed to save site data.\n", name.c_str());
         if (Core::getInstance().isWorldLoaded() && plugin_save_world_data && plugin_save_world_data(con) != CR_OK)
@@ -870,7 +910,12 @@ PluginManager::~PluginManager()
 
 void PluginManager::init()
 {
-    loadAll();
+    // DFHACK_PLUGIN_LOAD_THREADS=N checks plugin libraries on N threads
+    // (0 for one per core) and logs per-plugin load times
+    if (const char *threads = getenv("DFHACK_PLUGIN_LOAD_THREADS"))
+        loadAllParallel(std::max(0, atoi(threads)));
+    else
+        loadAll();
 
     bool any_loaded = false;
     for (auto p : all_plugins)
@@ -906,6 +951,8 @@ bool PluginManager::addPlugin(string name)
         return false;
     }
     Plugin * p = new Plugin(core, path, name, this);
+    // plugins are never removed from all_plugins, so the slot stays unique
+    p->perf_slot = all_plugins.size();
     all_plugins[name] = p;
     return true;
 }
@@ -965,6 +1012,108 @@ bool PluginManager::loadAll()
     return ok;
 }
 
+namespace {
+    struct PluginLoadJob {
+        Plugin *plugin;
+        buffered_color_ostream out;
+        bool opened = false;
+        double open_ms = 0;
+        double init_ms = 0;
+
+        PluginLoadJob(Plugin *plugin) : plugin(plugin) {}
+    };
+
+    double elapsed_ms(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+}
+
+// Like loadAll(), but each plugin is opened and checked on a pool of worker
+// threads. The dlopen calls themselves are serialized (see open_library), so
+// this mostly overlaps the symbol lookups and version checks. plugin_init and everything else that calls
+// into the plugin or Lua then runs on this thread in the same (name) order
+// as a serial load, so plugins see the same initialization order either way.
+bool PluginManager::loadAllParallel(size_t threads)
+{
+    typedef std::chrono::steady_clock clock;
+    auto start = clock::now();
+    auto &con = core->getConsole();
+
+    lock_guard<std::recursive_mutex> lock{*plugin_mutex};
+    auto files = listPlugins();
+    bool ok = true;
+    std::vector<std::unique_ptr<PluginLoadJob>> jobs;
+    for (auto &name : files)
+    {
+        Plugin *p = (*this)[name];
+        if (!p)
+        {
+            Core::printerr("Plugin failed to register: %s\n", name.c_str());
+            ok = false;
+        }
+        else if (p->begin_load(con))
+            jobs.emplace_back(new PluginLoadJob(p));
+        else if (p->getState() != Plugin::PS_LOADED)
+            ok = false;
+    }
+
+    CoreSuspender suspend;
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, jobs.size());
+    std::atomic<size_t> next_job(0);
+    auto open_worker = [&]() {
+        for (size_t i; (i = next_job++) < jobs.size(); )
+        {
+            auto &job = *jobs[i];
+            auto job_start = clock::now();
+            job.opened = job.plugin->open_library(job.out);
+            job.open_ms = elapsed_ms(job_start);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++)
+        workers.emplace_back(open_worker);
+    open_worker();
+    for (auto &worker : workers)
+        worker.join();
+    double open_total_ms = elapsed_ms(start);
+
+    for (auto &job : jobs)
+    {
+        job->out << std::flush;
+        for (auto &fragment : job->out.fragments())
+        {
+            con.color(fragment.first);
+            con << fragment.second;
+        }
+        con.reset_color();
+        con << std::flush;
+
+        if (!job->opened)
+        {
+            ok = false;
+            continue;
+        }
+        auto job_start = clock::now();
+        if (!job->plugin->init_library(con))
+            ok = false;
+        job->init_ms = elapsed_ms(job_start);
+    }
+
+    fprintf(stderr, "plugin load times (ms, %zu threads):\n", std::max<size_t>(threads, 1));
+    fprintf(stderr, "  %-24s %8s %8s\n", "plugin", "open", "init");
+    for (auto &job : jobs)
+        fprintf(stderr, "  %-24s %8.1f %8.1f%s\n", job->plugin->getName().c_str(),
+            job->open_ms, job->init_ms, job->plugin->getState() == Plugin::PS_LOADED ? "" : " (failed)");
+    fprintf(stderr, "loaded %zu plugins in %.1f ms (%.1f ms opening libraries)\n",
+        jobs.size(), elapsed_ms(start), open_total_ms);
+    fflush(stderr);
+    return ok;
+}
+
 bool PluginManager::unload (const string &name)
 {
     lock_guard<std::recursive_mutex> lock{*plugin_mutex};
@@ -1035,16 +1184,59 @@ bool PluginManager::CanInvokeHotkey(const std::string &command, df::viewscreen *
     return plugin ? plugin->can_invoke_hotkey(command, top) : true;
 }
 
+static uint32_t &slot_counter(std::vector<uint32_t> &counters, size_t slot)
+{
+    if (slot >= counters.size())
+        counters.resize(slot + 1);
+    return counters[slot];
+}
+
+static bool by_name(Plugin *a, Plugin *b)
+{
+    return a->getName() < b->getName();
+}
+
+static void dispatch_insert(std::vector<Plugin*> &dispatch, Plugin *p)
+{
+    auto it = std::lower_bound(dispatch.begin(), dispatch.end(), p, by_name);
+    if (it == dispatch.end() || *it != p)
+        dispatch.insert(it, p);
+}
+
+void PluginManager::addDispatch(Plugin *p)
+{
+    if (p->plugin_onupdate)
+        dispatch_insert(update_dispatch, p);
+    if (p->plugin_onstatechange)
+        dispatch_insert(state_change_dispatch, p);
+    if (p->plugin_save_world_data || p->plugin_save_site_data)
+        dispatch_insert(save_dispatch, p);
+    if (p->plugin_load_world_data || p->plugin_load_site_data)
+        dispatch_insert(load_dispatch, p);
+}
+
+void PluginManager::removeDispatch(Plugin *p)
+{
+    for (auto dispatch : {&update_dispatch, &state_change_dispatch, &save_dispatch, &load_dispatch})
+        vector_erase_at(*dispatch, linear_index(*dispatch, p));
+}
+
+// The dispatch loops below index instead of iterating so that a hook which
+// loads or unloads another plugin does not invalidate the loop.
+
 void PluginManager::OnUpdate(color_ostream &out)
 {
     auto &core = Core::getInstance();
     auto &counters = core.perf_counters;
-    for (auto it = begin(); it != end(); ++it) {
-        auto & plugin_name = it->first;
-        auto & plugin = it->second;
+    for (size_t i = 0; i < update_dispatch.size(); i++) {
+        Plugin *plugin = update_dispatch[i];
+        // plugins may flip their enabled flag directly, so check every frame
+        if (plugin->plugin_is_enabled && !*plugin->plugin_is_enabled)
+            continue;
         uint32_t start_ms = core.p->getTickCount();
+        FrameProfiler::Scope scope(core.frame_profiler, "plugin onUpdate", plugin);
         plugin->on_update(out);
-        counters.incCounter(counters.update_per_plugin[plugin_name], start_ms);
+        counters.incCounter(slot_counter(counters.update_per_plugin, plugin->perf_slot), start_ms);
     }
 }
 
@@ -1052,12 +1244,12 @@ void PluginManager::OnStateChange(color_ostream &out, state_change_event event)
 {
     auto &core = Core::getInstance();
     auto &counters = core.perf_counters;
-    for (auto it = begin(); it != end(); ++it) {
-        auto & plugin_name = it->first;
-        auto & plugin = it->second;
+    for (size_t i = 0; i < state_change_dispatch.size(); i++) {
+        Plugin *plugin = state_change_dispatch[i];
         uint32_t start_ms = core.p->getTickCount();
+        FrameProfiler::Scope scope(core.frame_profiler, "plugin onStateChange", plugin);
         plugin->on_state_change(out, event);
-        counters.incCounter(counters.state_change_per_plugin[plugin_name], start_ms);
+        counters.incCounter(slot_counter(counters.state_change_per_plugin, plugin->perf_slot), start_ms);
     }
 }
 
@@ -1090,41 +1282,44 @@ void PluginManager::unregisterCommands( Plugin * p )
 
 void PluginManager::doSaveData(color_ostream &out)
 {
-    for (auto it = begin(); it != end(); ++it)
+    for (size_t i = 0; i < save_dispatch.size(); i++)
     {
+        Plugin *plugin = save_dispatch[i];
         command_result cr = CR_NOT_IMPLEMENTED;
 
         if (World::IsSiteLoaded()) {
-            cr = it->second->save_site_data(out);
+            cr = plugin->save_site_data(out);
             if (cr != CR_OK && cr != CR_NOT_IMPLEMENTED)
-                out.printerr("Plugin %s has failed to save site data.\n", it->first.c_str());
+                out.printerr("Plugin %s has failed to save site data.\n", plugin->getName().c_str());
         }
 
-        cr = it->second->save_world_data(out);
+        cr = plugin->save_world_data(out);
         if (cr != CR_OK && cr != CR_NOT_IMPLEMENTED)
-            out.printerr("Plugin %s has failed to save world data.\n", it->first.c_str());
+            out.printerr("Plugin %s has failed to save world data.\n", plugin->getName().c_str());
     }
 }
 
 void PluginManager::doLoadWorldData(color_ostream &out)
 {
-    for (auto it = begin(); it != end(); ++it)
+    for (size_t i = 0; i < load_dispatch.size(); i++)
     {
-        command_result cr = it->second->load_world_data(out);
+        Plugin *plugin = load_dispatch[i];
+        command_result cr = plugin->load_world_data(out);
 
         if (cr != CR_OK && cr != CR_NOT_IMPLEMENTED)
-            out.printerr("Plugin %s has failed to load saved world data.\n", it->first.c_str());
+            out.printerr("Plugin %s has failed to load saved world data.\n", plugin->getName().c_str());
     }
 }
 
 void PluginManager::doLoadSiteData(color_ostream &out)
 {
-    for (auto it = begin(); it != end(); ++it)
+    for (size_t i = 0; i < load_dispatch.size(); i++)
     {
-        command_result cr = it->second->load_site_data(out);
+        Plugin *plugin = load_dispatch[i];
+        command_result cr = plugin->load_site_data(out);
 
         if (cr != CR_OK && cr != CR_NOT_IMPLEMENTED)
-            out.printerr("Plugin %s has failed to load saved site data.\n", it->first.c_str());
+            out.printerr("Plugin %s has failed to load saved site data.\n", plugin->getName().c_str());
     }
 }
 
@@ -57,9 +57,23 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <cstdlib>
 #include <sstream>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <set>
 #include <thread>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 #include "json/json.h"
 
 using namespace std;
@@ -69,11 +83,7 @@ using dfproto::CoreTextNotification;
 using dfproto::CoreTextFragment;
 using google::protobuf::MessageLite;
 
-bool readFullBuffer(CSimpleSocket *socket, void *buf, int size);
-bool sendRemoteMessage(CSimpleSocket *socket, int16_t id,
-                        const ::google::protobuf::MessageLite *msg, bool size_ready);
-
-std::mutex ServerMain::access_{};
+std::shared_mutex ServerMain::access_{};
 bool ServerMain::blocked_{};
 
 namespace {
@@ -88,8 +98,10 @@ namespace {
 namespace DFHack {
     DBG_DECLARE(core, socket, DebugCategory::LINFO);
 
+    // Held for the duration of a request. Requests on different workers
+    // can run concurrently; block() waits for all of them to finish.
     struct BlockGuard {
-        std::lock_guard<std::mutex> lock;
+        std::shared_lock<std::shared_mutex> lock;
         BlockGuard() :
             lock{ServerMain::access_}
         {
@@ -153,11 +165,11 @@ void RPCService::dumpMethods(std::ostream & out) const
     }
 }
 
-ServerConnection::ServerConnection(CActiveSocket *socket)
-    : socket(socket), stream(this)
+ServerConnection::ServerConnection(ServerMainImpl *server, CActiveSocket *socket, size_t worker)
+    : in_error(false), socket(socket), stream(this),
+      server(server), worker(worker),
+      handshake_done(false), busy(false), closing(false)
 {
-    in_error = false;
-
     core_service = new CoreService();
     core_service->finalize(this, &functions);
 }
@@ -231,190 +243,489 @@ void ServerConnection::connection_ostream::flush_proxy()
 
     buffer.clear();
 
-    if (!sendRemoteMessage(owner->socket, RPC_REPLY_TEXT, &msg, false))
-    {
-        owner->in_error = true;
+    if (!owner->sendMessage(RPC_REPLY_TEXT, &msg, false))
         Core::printerr("Error writing text into client socket.\n");
-    }
 }
 
-void ServerConnection::Accepted(CActiveSocket* socket)
+void ServerConnection::handleRequest(int16_t id, const uint8_t *data, int in_size)
 {
-    std::thread{[](CActiveSocket* socket) {
-            try {
-                ServerConnection(socket).threadFn();
-            } catch (BlockedException &) {
-            }
-        },  socket}.detach();
-}
+    BlockGuard lock;
 
-void ServerConnection::threadFn()
-{
-    color_ostream_proxy out(Core::getInstance().getConsole());
-
-    /* Handshake */
+    ServerFunctionBase *fn = vector_get(functions, id);
+    MessageLite *reply = NULL;
+    command_result res = CR_FAILURE;
 
+    if (!fn)
     {
-        RPCHandshakeHeader header;
-
-        if (!readFullBuffer(socket, &header, sizeof(header)))
+        stream.printerr("RPC call of invalid id %d\n", id);
+    }
+    else
+    {
+        if (((fn->flags & SF_ALLOW_REMOTE) != SF_ALLOW_REMOTE) && strcmp(socket->GetClientAddr(), "127.0.0.1") != 0)
         {
-            out << "In RPC server: could not read handshake header." << endl;
-            return;
+            stream.printerr("In call to %s: forbidden host: %s\n", fn->name, socket->GetClientAddr());
         }
-
-        if (memcmp(header.magic, RPCHandshakeHeader::REQUEST_MAGIC, sizeof(header.magic)) ||
-            header.version < 1 || header.version > 255)
+        else if (!fn->in()->ParseFromArray(data, in_size))
         {
-            out << "In RPC server: invalid handshake header." << endl;
-            return;
+            stream.printerr("In call to %s: could not decode input args.\n", fn->name);
         }
+        else
+        {
+            reply = fn->out();
 
-        memcpy(header.magic, RPCHandshakeHeader::RESPONSE_MAGIC, sizeof(header.magic));
-        header.version = 1;
+            if (fn->flags & SF_DONT_SUSPEND)
+            {
+                res = fn->execute(stream);
+            }
+            else
+            {
+                CoreSuspender suspend;
+                res = fn->execute(stream);
+            }
 
-        if (socket->Send((uint8*)&header, sizeof(header)) != sizeof(header))
-        {
-            out << "In RPC server: could not send handshake response." << endl;
-            return;
+            if (res == CR_OK)
+                res = fn->finish(stream);
         }
     }
 
-    /* Processing */
+    // Flush all text output
+    if (in_error)
+        return;
+
+    // Send reply
+    int out_size = (reply ? reply->ByteSize() : 0);
 
-    std::cerr << "Client connection established." << endl;
+    if (out_size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+    {
+        stream.printerr("In call to %s: reply too large: %d.\n",
+                            (fn ? fn->name : "UNKNOWN"), out_size);
+        res = CR_LINK_FAILURE;
+    }
+
+    stream.flush();
 
-    while (!in_error) {
-        // Read the message
+    if (res == CR_OK && reply)
+    {
+        if (!sendMessage(RPC_REPLY_RESULT, reply, true))
+            return;
+    }
+    else
+    {
         RPCMessageHeader header;
+        header.id = RPC_REPLY_FAIL;
+        header.size = res;
 
-        if (!readFullBuffer(socket, &header, sizeof(header)))
-        {
-            out.printerr("In RPC server: I/O error in receive header.\n");
-            break;
-        }
+        if (!sendData(&header, sizeof(header)))
+            return;
+    }
 
-        if ((DFHack::DFHackReplyCode)header.id == RPC_REQUEST_QUIT)
-            break;
+    // Cleanup
+    if (fn)
+    {
+        fn->reset((fn->flags & SF_CALLED_ONCE) ||
+                  (out_size > 128*1024 || in_size > 32*1024));
+    }
+}
 
-        if (header.size < 0 || header.size > RPCMessageHeader::MAX_MESSAGE_SIZE)
-        {
-            out.printerr("In RPC server: invalid received size %d.\n", header.size);
-            break;
-        }
+bool ServerConnection::sendMessage(int16_t id, const MessageLite *msg, bool size_ready)
+{
+    int size = size_ready ? msg->GetCachedSize() : msg->ByteSize();
+    int fullsz = size + sizeof(RPCMessageHeader);
 
-        std::unique_ptr<uint8_t[]> buf(new uint8_t[header.size]);
+    std::unique_ptr<uint8_t[]> data(new uint8_t[fullsz]);
+    RPCMessageHeader *hdr = (RPCMessageHeader*)data.get();
 
-        if (!readFullBuffer(socket, buf.get(), header.size))
-        {
-            out.printerr("In RPC server: I/O error in receive %d bytes of data.\n", header.size);
-            break;
-        }
+    hdr->id = id;
+    hdr->size = size;
 
-        //out.print("Handling %d:%d\n", header.id, header.size);
+    uint8_t *pstart = data.get() + sizeof(RPCMessageHeader);
+    uint8_t *pend = msg->SerializeWithCachedSizesToArray(pstart);
+    assert((pend - pstart) == size);
+    (void)pend;
 
-        // Find and call the function
-        int in_size = header.size;
-        BlockGuard lock;
+    return sendData(data.get(), fullsz);
+}
 
-        ServerFunctionBase *fn = vector_get(functions, header.id);
-        MessageLite *reply = NULL;
-        command_result res = CR_FAILURE;
+namespace {
+    // Output a connection may have queued before the worker sending more
+    // has to wait for the event loop to write it out.
+    const size_t MAX_PENDING_OUTPUT = 1 << 20;
+    // How long a worker waits for a client to read its replies.
+    const std::chrono::seconds OUTPUT_TIMEOUT{30};
+    const int READ_CHUNK = 64 * 1024;
+
+    typedef decltype(std::declval<CSimpleSocket&>().GetSocketDescriptor()) socket_t;
+
+    // Readiness notification for the server event loop: epoll on linux,
+    // poll() everywhere else. Sockets are reported by the context pointer
+    // they were registered with.
+    class Poller {
+    public:
+        enum { READ = 1, WRITE = 2, HANGUP = 4 };
+
+        struct Event {
+            void *ctx;
+            int events;
+        };
+
+        Poller();
+        ~Poller();
+
+        bool ok() const;
+        // Register the socket or change the events it is watched for.
+        // Errors and hangups are always reported.
+        void set(socket_t fd, void *ctx, int events);
+        void remove(socket_t fd);
+        // Interrupt wait() from another thread.
+        void wake();
+        void wait(int timeout_ms, std::vector<Event> &events);
+
+    private:
+        std::map<socket_t, int> registered;
+#ifdef __linux__
+        int epfd;
+        int wakefd;
+#else
+        // the read end is always fds[0]
+        socket_t wake_rd;
+        socket_t wake_wr;
+        std::vector<pollfd> fds;
+        std::vector<void*> ctxs;
+#endif
+    };
 
-        if (!fn)
-        {
-            stream.printerr("RPC call of invalid id %d\n", header.id);
+#ifdef __linux__
+
+    Poller::Poller()
+    {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epfd >= 0 && wakefd >= 0)
+            epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev);
+    }
+
+    Poller::~Poller()
+    {
+        if (wakefd >= 0)
+            close(wakefd);
+        if (epfd >= 0)
+            close(epfd);
+    }
+
+    bool Poller::ok() const
+    {
+        return epfd >= 0 && wakefd >= 0;
+    }
+
+    void Poller::set(socket_t fd, void *ctx, int events)
+    {
+        auto it = registered.find(fd);
+        if (it != registered.end() && it->second == events)
+            return;
+
+        epoll_event ev = {};
+        ev.events = ((events & READ) ? EPOLLIN : 0) | ((events & WRITE) ? EPOLLOUT : 0);
+        ev.data.ptr = ctx;
+        epoll_ctl(epfd, it == registered.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+        registered[fd] = events;
+    }
+
+    void Poller::remove(socket_t fd)
+    {
+        if (registered.erase(fd))
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    }
+
+    void Poller::wake()
+    {
+        uint64_t one = 1;
+        if (write(wakefd, &one, sizeof(one)) < 0) {
+            // already pending
         }
-        else
+    }
+
+    void Poller::wait(int timeout_ms, std::vector<Event> &events)
+    {
+        events.clear();
+
+        epoll_event evs[64];
+        int cnt = epoll_wait(epfd, evs, 64, timeout_ms);
+
+        for (int i = 0; i < cnt; i++)
         {
-            if (((fn->flags & SF_ALLOW_REMOTE) != SF_ALLOW_REMOTE) && strcmp(socket->GetClientAddr(), "127.0.0.1") != 0)
-            {
-                stream.printerr("In call to %s: forbidden host: %s\n", fn->name, socket->GetClientAddr());
-            }
-            else if (!fn->in()->ParseFromArray(buf.get(), header.size))
+            if (!evs[i].data.ptr)
             {
-                stream.printerr("In call to %s: could not decode input args.\n", fn->name);
+                uint64_t val;
+                if (read(wakefd, &val, sizeof(val)) < 0) {
+                    // spurious
+                }
+                continue;
             }
-            else
-            {
-                buf.reset();
 
-                reply = fn->out();
+            int flags = 0;
+            if (evs[i].events & EPOLLIN)
+                flags |= READ;
+            if (evs[i].events & EPOLLOUT)
+                flags |= WRITE;
+            if (evs[i].events & (EPOLLERR | EPOLLHUP))
+                flags |= HANGUP;
+            events.push_back({ evs[i].data.ptr, flags });
+        }
+    }
 
-                if (fn->flags & SF_DONT_SUSPEND)
-                {
-                    res = fn->execute(stream);
-                }
-                else
-                {
-                    CoreSuspender suspend;
-                    res = fn->execute(stream);
-                }
+#else
+
+    // wake() writes to a pipe, or on Windows, where poll() only takes
+    // sockets, to a loopback UDP socket connected to itself. Winsock has
+    // already been started by the listening socket, which is constructed
+    // before the poller.
+    Poller::Poller()
+    {
+#ifdef _WIN32
+        wake_rd = wake_wr = INVALID_SOCKET;
+        SOCKET s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int len = sizeof(addr);
+        u_long nonblock = 1;
+        if (s != INVALID_SOCKET &&
+            bind(s, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+            getsockname(s, (sockaddr*)&addr, &len) == 0 &&
+            connect(s, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+            ioctlsocket(s, FIONBIO, &nonblock) == 0)
+            wake_rd = wake_wr = s;
+        else if (s != INVALID_SOCKET)
+            closesocket(s);
+#else
+        wake_rd = wake_wr = -1;
+        int p[2];
+        if (pipe(p) == 0)
+        {
+            for (int fd : p)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
             }
+            wake_rd = p[0];
+            wake_wr = p[1];
         }
+#endif
 
-        // Flush all text output
-        if (in_error)
-            break;
+        pollfd pfd = {};
+        pfd.fd = wake_rd;
+        pfd.events = POLLIN;
+        fds.push_back(pfd);
+        ctxs.push_back(NULL);
+    }
 
-        //out.print("Answer %d:%d\n", res, reply);
+    Poller::~Poller()
+    {
+#ifdef _WIN32
+        if (wake_rd != INVALID_SOCKET)
+            closesocket(wake_rd);
+#else
+        if (wake_rd >= 0)
+            close(wake_rd);
+        if (wake_wr >= 0)
+            close(wake_wr);
+#endif
+    }
+
+    bool Poller::ok() const
+    {
+#ifdef _WIN32
+        return wake_rd != INVALID_SOCKET;
+#else
+        return wake_rd >= 0;
+#endif
+    }
 
-        // Send reply
-        int out_size = (reply ? reply->ByteSize() : 0);
+    void Poller::set(socket_t fd, void *ctx, int events)
+    {
+        short mask = ((events & READ) ? POLLIN : 0) | ((events & WRITE) ? POLLOUT : 0);
 
-        if (out_size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+        for (size_t i = 0; i < fds.size(); i++)
         {
-            stream.printerr("In call to %s: reply too large: %d.\n",
-                                (fn ? fn->name : "UNKNOWN"), out_size);
-            res = CR_LINK_FAILURE;
+            if (fds[i].fd != fd)
+                continue;
+            fds[i].events = mask;
+            ctxs[i] = ctx;
+            registered[fd] = events;
+            return;
         }
 
-        stream.flush();
+        pollfd pfd = {};
+        pfd.fd = fd;
+        pfd.events = mask;
+        fds.push_back(pfd);
+        ctxs.push_back(ctx);
+        registered[fd] = events;
+    }
+
+    void Poller::remove(socket_t fd)
+    {
+        if (!registered.erase(fd))
+            return;
 
-        if (res == CR_OK && reply)
+        for (size_t i = 0; i < fds.size(); i++)
         {
-            if (!sendRemoteMessage(socket, RPC_REPLY_RESULT, reply, true))
-            {
-                out.printerr("In RPC server: I/O error in send result.\n");
-                break;
-            }
+            if (fds[i].fd != fd)
+                continue;
+            fds.erase(fds.begin() + i);
+            ctxs.erase(ctxs.begin() + i);
+            return;
         }
-        else
-        {
-            header.id = RPC_REPLY_FAIL;
-            header.size = res;
+    }
 
-            if (socket->Send((uint8_t*)&header, sizeof(header)) != sizeof(header))
-            {
-                out.printerr("In RPC server: I/O error in send failure code.\n");
-                break;
-            }
+    void Poller::wake()
+    {
+        char byte = 0;
+#ifdef _WIN32
+        send(wake_wr, &byte, 1, 0);
+#else
+        if (write(wake_wr, &byte, 1) < 0) {
+            // already pending
+        }
+#endif
+    }
+
+    void Poller::wait(int timeout_ms, std::vector<Event> &events)
+    {
+        events.clear();
+
+#ifdef _WIN32
+        int cnt = WSAPoll(fds.data(), (ULONG)fds.size(), timeout_ms);
+#else
+        int cnt = poll(fds.data(), fds.size(), timeout_ms);
+#endif
+
+        if (cnt > 0 && fds[0].revents)
+        {
+            char buf[64];
+#ifdef _WIN32
+            while (recv(wake_rd, buf, sizeof(buf), 0) > 0) {}
+#else
+            while (read(wake_rd, buf, sizeof(buf)) > 0) {}
+#endif
+            cnt--;
         }
 
-        // Cleanup
-        if (fn)
+        for (size_t i = 1; cnt > 0 && i < fds.size(); i++)
         {
-            fn->reset((fn->flags & SF_CALLED_ONCE) ||
-                      (out_size > 128*1024 || in_size > 32*1024));
+            if (!fds[i].revents)
+                continue;
+
+            int flags = 0;
+            if (fds[i].revents & POLLIN)
+                flags |= READ;
+            if (fds[i].revents & POLLOUT)
+                flags |= WRITE;
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+                flags |= HANGUP;
+            events.push_back({ ctxs[i], flags });
+            cnt--;
         }
     }
 
-    std::cerr << "Shutting down client connection." << endl;
+#endif
+
 }
 
-namespace {
+namespace DFHack {
 
+    // A single thread accepts connections and does all socket I/O. Complete
+    // requests are queued to a pool of workers; each connection is pinned to
+    // one worker so that state like CoreSuspend locks stays on one thread.
+    // A connection isn't read from while its request is queued or running,
+    // and a worker waits while too much of its output is still unsent.
     struct ServerMainImpl : public ServerMain {
         CPassiveSocket socket;
+        bool listening;
+        size_t max_connections;
+        size_t worker_count;
+
+        Poller poller;
+        std::set<ServerConnection*> connections;
+        std::vector<ServerConnection*> closed;
+        bool accepting;
+        size_t next_worker;
+
+        struct Job {
+            ServerConnection *conn;
+            int16_t id;
+            std::unique_ptr<uint8_t[]> data;
+            int size;
+            // delete the connection instead of running a request
+            bool close;
+        };
+
+        struct Worker {
+            std::thread thread;
+            std::deque<Job> jobs;
+            std::condition_variable cv;
+            // set while a connection has the core suspended on this thread;
+            // until it resumes, other connections' jobs wait
+            ServerConnection *owner = NULL;
+        };
+
+        // guards the job queues, the finished list and stopping
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<ServerConnection*> finished;
+        bool stopping;
+
         static void threadFn(std::promise<bool> promise, int port);
         ServerMainImpl(std::promise<bool> promise, int port);
         ~ServerMainImpl();
+
+        void wake() { poller.wake(); }
+
+        void run();
+        void acceptClients();
+        void readFrom(ServerConnection *conn);
+        void processInput(ServerConnection *conn);
+        void writeTo(ServerConnection *conn);
+        void closeConnection(ServerConnection *conn);
+        void collectFinished();
+        void pumpConnections();
+        void queueJob(Job job);
+        void workerFn(Worker *worker);
     };
 
 }
 
+bool ServerConnection::sendData(const void *data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(output_mutex);
+
+    while (!in_error && output.size() >= MAX_PENDING_OUTPUT)
+    {
+        if (output_drained.wait_for(lock, OUTPUT_TIMEOUT) == std::cv_status::timeout &&
+            output.size() >= MAX_PENDING_OUTPUT)
+        {
+            WARN(socket).print("In RPC server: client is not reading replies, dropping connection.\n");
+            in_error = true;
+        }
+    }
+
+    if (in_error)
+        return false;
+
+    output.append((const char*)data, size);
+    lock.unlock();
+
+    server->wake();
+    return true;
+}
+
 ServerMainImpl::ServerMainImpl(std::promise<bool> promise, int port) :
-    socket{}
+    socket{}, listening(false), max_connections(64), worker_count(1),
+    accepting(true), next_worker(0), stopping(false)
 {
     socket.Initialize();
 
@@ -423,6 +734,8 @@ ServerMainImpl::ServerMainImpl(std::promise<bool> promise, int port) :
     Json::Value configJson;
 
     bool allow_remote = false;
+    int max_conn = (int)max_connections;
+    int workers = (int)worker_count;
 
     std::ifstream inFile(filename, std::ios_base::in);
     try {
@@ -430,6 +743,8 @@ ServerMainImpl::ServerMainImpl(std::promise<bool> promise, int port) :
         {
             inFile >> configJson;
             allow_remote = configJson.get("allow_remote", "false").asBool();
+            max_conn = configJson.get("max_connections", max_conn).asInt();
+            workers = configJson.get("worker_threads", workers).asInt();
         }
     } catch (const std::exception & e) {
         std::cerr << "Error reading remote server config file: " << filename << ": " << e.what() << std::endl;
@@ -437,9 +752,14 @@ ServerMainImpl::ServerMainImpl(std::promise<bool> promise, int port) :
     }
     inFile.close();
 
+    max_connections = std::max(max_conn, 1);
+    worker_count = std::max(workers, 1);
+
     // rewrite/normalize config file
     configJson["allow_remote"] = allow_remote;
     configJson["port"] = configJson.get("port", RemoteClient::DEFAULT_PORT);
+    configJson["max_connections"] = (int)max_connections;
+    configJson["worker_threads"] = (int)worker_count;
 
     std::ofstream outFile(filename, std::ios_base::trunc);
 
@@ -451,10 +771,11 @@ ServerMainImpl::ServerMainImpl(std::promise<bool> promise, int port) :
 
     std::cerr << "Listening on port " << port << (allow_remote ? " (remote enabled)" : "") << std::endl;
     const char* addr = allow_remote ? NULL : "127.0.0.1";
-    if (!socket.Listen(addr, port)) {
+    if (!poller.ok() || !socket.Listen(addr, port)) {
         promise.set_value(false);
         return;
     }
+    listening = true;
     promise.set_value(true);
 }
 
@@ -475,33 +796,381 @@ void ServerMainImpl::threadFn(std::promise<bool> promise, int port)
 {
     ServerMainImpl server{std::move(promise), port};
 
-    server.socket.SetBlocking();
-    try {
-        while (server.socket.IsSocketValid()) {
-            if (std::unique_ptr<CActiveSocket> client{server.socket.Accept()}) {
-                BlockGuard lock;
-                ServerConnection::Accepted(client.release());
+    if (server.listening)
+        server.run();
+}
+
+void ServerMainImpl::run()
+{
+    socket.SetNonblocking();
+    poller.set(socket.GetSocketDescriptor(), this, Poller::READ);
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        workers.emplace_back(new Worker());
+        Worker *worker = workers.back().get();
+        worker->thread = std::thread([this, worker] { workerFn(worker); });
+    }
+
+    std::vector<Poller::Event> events;
+
+    while (socket.IsSocketValid())
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(access_);
+            if (blocked_)
+                break;
+        }
+
+        poller.wait(250, events);
+
+        for (auto &ev : events)
+        {
+            if (ev.ctx == this)
+            {
+                acceptClients();
+                continue;
             }
-            else switch (server.socket.GetSocketError()) {
+
+            // closed connections are only deleted in pumpConnections,
+            // so this is still valid even if an earlier event closed it
+            auto conn = (ServerConnection*)ev.ctx;
+            if (conn->closing)
+                continue;
+
+            if (ev.events & Poller::HANGUP)
+                closeConnection(conn);
+            else if (ev.events & Poller::READ)
+                readFrom(conn);
+        }
+
+        collectFinished();
+        pumpConnections();
+    }
+
+    // Drop all clients, waiting for requests in progress to finish first.
+    std::vector<ServerConnection*> all(connections.begin(), connections.end());
+    for (auto conn : all)
+        closeConnection(conn);
+    pumpConnections();
+
+    while (!connections.empty())
+    {
+        poller.wait(250, events);
+        collectFinished();
+        pumpConnections();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    for (auto &worker : workers)
+    {
+        worker->cv.notify_all();
+        worker->thread.join();
+    }
+}
+
+void ServerMainImpl::acceptClients()
+{
+    while (connections.size() < max_connections)
+    {
+        std::unique_ptr<CActiveSocket> client{socket.Accept()};
+        if (!client)
+        {
+            switch (socket.GetSocketError()) {
             case CSimpleSocket::SocketInvalidSocket:
                 WARN(socket).print("Listening socket invalid, shutting down RemoteServer\n");
-                server.socket.Close();
+                socket.Close();
                 break;
             case CSimpleSocket::SocketFirewallError:
             case CSimpleSocket::SocketProtocolError:
-                WARN(socket).print("Connection failed: %s\n", server.socket.DescribeError());
+                WARN(socket).print("Connection failed: %s\n", socket.DescribeError());
                 break;
             default:
                 break;
             }
+            return;
+        }
+
+        client->SetNonblocking();
+        socket_t fd = client->GetSocketDescriptor();
+
+        auto conn = new ServerConnection(this, client.release(), next_worker++ % worker_count);
+        connections.insert(conn);
+        poller.set(fd, conn, Poller::READ);
+    }
+
+    // Leave further clients in the listen backlog until a connection closes.
+    if (accepting)
+    {
+        DEBUG(socket).print("Connection limit of %zu reached\n", max_connections);
+        poller.set(socket.GetSocketDescriptor(), this, 0);
+        accepting = false;
+    }
+}
+
+void ServerMainImpl::readFrom(ServerConnection *conn)
+{
+    while (!conn->busy && !conn->closing)
+    {
+        int cnt = conn->socket->Receive(READ_CHUNK);
+        if (cnt > 0)
+        {
+            conn->input.append((const char*)conn->socket->GetData(), cnt);
+            processInput(conn);
+            continue;
+        }
+
+        if (cnt < 0 && conn->socket->GetSocketError() == CSimpleSocket::SocketEwouldblock)
+            return;
+
+        if (cnt < 0) {
+            DEBUG(socket).print("In RPC server: I/O error in receive: %s\n",
+                                conn->socket->DescribeError());
+        }
+        closeConnection(conn);
+        return;
+    }
+}
+
+void ServerMainImpl::processInput(ServerConnection *conn)
+{
+    if (conn->busy || conn->closing)
+        return;
+
+    /* Handshake */
+
+    if (!conn->handshake_done)
+    {
+        RPCHandshakeHeader header;
+
+        if (conn->input.size() < sizeof(header))
+            return;
+
+        memcpy(&header, conn->input.data(), sizeof(header));
+        conn->input.erase(0, sizeof(header));
+
+        if (memcmp(header.magic, RPCHandshakeHeader::REQUEST_MAGIC, sizeof(header.magic)) ||
+            header.version < 1 || header.version > 255)
+        {
+            WARN(socket).print("In RPC server: invalid handshake header.\n");
+            closeConnection(conn);
+            return;
+        }
+
+        memcpy(header.magic, RPCHandshakeHeader::RESPONSE_MAGIC, sizeof(header.magic));
+        header.version = 1;
+
+        {
+            std::lock_guard<std::mutex> lock(conn->output_mutex);
+            conn->output.append((const char*)&header, sizeof(header));
+        }
+
+        conn->handshake_done = true;
+        std::cerr << "Client connection established." << endl;
+    }
+
+    /* Processing */
+
+    RPCMessageHeader header;
+
+    if (conn->input.size() < sizeof(header))
+        return;
+
+    memcpy(&header, conn->input.data(), sizeof(header));
+
+    if ((DFHack::DFHackReplyCode)header.id == RPC_REQUEST_QUIT)
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    if (header.size < 0 || header.size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+    {
+        WARN(socket).print("In RPC server: invalid received size %d.\n", header.size);
+        closeConnection(conn);
+        return;
+    }
+
+    if (conn->input.size() < sizeof(header) + header.size)
+        return;
+
+    Job job = { conn, header.id, std::unique_ptr<uint8_t[]>(new uint8_t[header.size]), header.size, false };
+    memcpy(job.data.get(), conn->input.data() + sizeof(header), header.size);
+    conn->input.erase(0, sizeof(header) + header.size);
+
+    conn->busy = true;
+    queueJob(std::move(job));
+}
+
+void ServerMainImpl::writeTo(ServerConnection *conn)
+{
+    bool pending;
+
+    {
+        std::lock_guard<std::mutex> lock(conn->output_mutex);
+
+        size_t sent = 0;
+        while (sent < conn->output.size())
+        {
+            int cnt = conn->socket->Send((const uint8_t*)conn->output.data() + sent,
+                                         conn->output.size() - sent);
+            if (cnt > 0)
+            {
+                sent += cnt;
+                continue;
+            }
+
+            if (cnt < 0 && conn->socket->GetSocketError() == CSimpleSocket::SocketEwouldblock)
+                break;
+
+            WARN(socket).print("In RPC server: I/O error in send.\n");
+            conn->in_error = true;
+            break;
         }
+
+        conn->output.erase(0, sent);
+        pending = !conn->output.empty() && !conn->in_error;
+
+        if (sent || conn->in_error)
+            conn->output_drained.notify_all();
     }
-    catch(BlockedException &) {
+
+    if (conn->in_error)
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    int events = (conn->busy ? 0 : Poller::READ) | (pending ? Poller::WRITE : 0);
+    poller.set(conn->socket->GetSocketDescriptor(), conn, events);
+}
+
+void ServerMainImpl::closeConnection(ServerConnection *conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(conn->output_mutex);
+        conn->in_error = true;
+        conn->output_drained.notify_all();
+    }
+    if (!conn->closing)
+    {
+        conn->closing = true;
+        poller.remove(conn->socket->GetSocketDescriptor());
+    }
+
+    // a running request keeps it alive until collectFinished()
+    if (conn->busy || !connections.erase(conn))
+        return;
+
+    if (conn->handshake_done)
+        std::cerr << "Shutting down client connection." << endl;
+
+    closed.push_back(conn);
+}
+
+void ServerMainImpl::collectFinished()
+{
+    std::vector<ServerConnection*> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(finished);
+    }
+
+    for (auto conn : done)
+    {
+        conn->busy = false;
+        if (conn->closing || conn->in_error)
+            closeConnection(conn);
+        else
+            // the client may already have sent its next request
+            processInput(conn);
+    }
+}
+
+void ServerMainImpl::pumpConnections()
+{
+    std::vector<ServerConnection*> live(connections.begin(), connections.end());
+    for (auto conn : live)
+    {
+        if (!conn->closing)
+            writeTo(conn);
+    }
+
+    // ServerConnection is deleted by its own worker, which also
+    // releases anything a CoreSuspend call left held.
+    for (auto conn : closed)
+        queueJob({ conn, 0, nullptr, 0, true });
+    closed.clear();
+
+    if (!accepting && connections.size() < max_connections && socket.IsSocketValid())
+    {
+        poller.set(socket.GetSocketDescriptor(), this, Poller::READ);
+        accepting = true;
+    }
+}
+
+void ServerMainImpl::queueJob(Job job)
+{
+    Worker *worker = workers[job.conn->worker].get();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        worker->jobs.push_back(std::move(job));
+    }
+    worker->cv.notify_one();
+}
+
+void ServerMainImpl::workerFn(Worker *worker)
+{
+    auto next_job = [worker] {
+        if (!worker->owner)
+            return worker->jobs.begin();
+        return std::find_if(worker->jobs.begin(), worker->jobs.end(),
+                            [worker](const Job &job) { return job.conn == worker->owner; });
+    };
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        worker->cv.wait(lock, [&] { return stopping || next_job() != worker->jobs.end(); });
+        auto it = next_job();
+        if (it == worker->jobs.end())
+            return;
+
+        Job job = std::move(*it);
+        worker->jobs.erase(it);
+        lock.unlock();
+
+        if (job.close)
+        {
+            delete job.conn;
+            worker->owner = NULL;
+        }
+        else
+        {
+            try {
+                job.conn->handleRequest(job.id, job.data.get(), job.size);
+            } catch (BlockedException &) {
+                job.conn->in_error = true;
+            }
+            job.data.reset();
+            worker->owner = job.conn->core_service->isSuspended() ? job.conn : NULL;
+        }
+
+        lock.lock();
+        if (!job.close)
+        {
+            finished.push_back(job.conn);
+            poller.wake();
+        }
     }
 }
 
 void ServerMain::block()
 {
-    std::lock_guard<std::mutex> lock{access_};
+    std::unique_lock<std::shared_mutex> lock{access_};
     blocked_ = true;
 }
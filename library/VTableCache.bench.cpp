@@ -0,0 +1,55 @@
+#include "VTableCache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace DFHack;
+
+// Compares vtable lookups through VTableCache against the mutex-protected
+// std::map that virtual_identity::find used before.
+TEST(VTableCache, lookup) {
+    const int CLASSES = 2000, LOOKUPS = 10000000;
+    typedef std::chrono::steady_clock clock;
+    struct Identity { int id; };
+
+    std::vector<Identity> ids(CLASSES);
+    std::vector<void*> vtables;
+    std::map<void*, Identity*> known;
+    std::mutex known_mutex;
+    auto cache = std::make_unique<VTableCache<Identity>>();
+    for (int i = 0; i < CLASSES; i++) {
+        ids[i].id = i;
+        void *vtable = reinterpret_cast<void*>(0x400000 + i * 0x48);
+        vtables.push_back(vtable);
+        known[vtable] = &ids[i];
+        cache->insert(vtable, &ids[i]);
+    }
+
+    int64_t sum_map = 0, sum_cache = 0;
+    auto t0 = clock::now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        std::lock_guard<std::mutex> lock(known_mutex);
+        sum_map += known.find(vtables[(i * 7) % CLASSES])->second->id;
+    }
+    auto t1 = clock::now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        Identity *id = NULL;
+        if (cache->find(vtables[(i * 7) % CLASSES], &id))
+            sum_cache += id->id;
+    }
+    auto t2 = clock::now();
+
+    EXPECT_EQ(sum_map, sum_cache);
+
+    using std::chrono::microseconds;
+    using std::chrono::duration_cast;
+    std::cout << LOOKUPS << " lookups over " << CLASSES << " vtables: std::map + mutex "
+              << duration_cast<microseconds>(t1 - t0).count() << " us, VTableCache "
+              << duration_cast<microseconds>(t2 - t1).count() << " us" << std::endl;
+}
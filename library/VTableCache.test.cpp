@@ -0,0 +1,87 @@
+#include "VTableCache.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+using namespace DFHack;
+
+namespace {
+    struct Identity { int id; };
+
+    void *fake_vtable(uintptr_t n) {
+        return reinterpret_cast<void*>(0x10000 + n * 8);
+    }
+
+    // vtables that all hash to the same slot as the first one
+    std::vector<void*> colliding_vtables(size_t count) {
+        std::vector<void*> out;
+        size_t target = VTableCache<Identity>::hash(fake_vtable(0));
+        for (uintptr_t n = 0; out.size() < count; n++)
+            if (VTableCache<Identity>::hash(fake_vtable(n)) == target)
+                out.push_back(fake_vtable(n));
+        return out;
+    }
+}
+
+TEST(VTableCache, find_insert) {
+    auto cache = std::make_unique<VTableCache<Identity>>();
+    Identity a{1}, b{2};
+    Identity *out = &a;
+
+    EXPECT_FALSE(cache->find(fake_vtable(1), &out));
+    cache->insert(fake_vtable(1), &a);
+    cache->insert(fake_vtable(2), &b);
+    ASSERT_TRUE(cache->find(fake_vtable(1), &out));
+    EXPECT_EQ(out, &a);
+    ASSERT_TRUE(cache->find(fake_vtable(2), &out));
+    EXPECT_EQ(out, &b);
+
+    cache->insert(fake_vtable(1), &b);
+    ASSERT_TRUE(cache->find(fake_vtable(1), &out));
+    EXPECT_EQ(out, &b);
+}
+
+TEST(VTableCache, negative_entries) {
+    auto cache = std::make_unique<VTableCache<Identity>>();
+    Identity a{1};
+    Identity *out = &a;
+
+    cache->insert(fake_vtable(3), NULL);
+    ASSERT_TRUE(cache->find(fake_vtable(3), &out));
+    EXPECT_EQ(out, nullptr);
+}
+
+TEST(VTableCache, invalidate) {
+    auto cache = std::make_unique<VTableCache<Identity>>();
+    Identity a{1}, b{2};
+    Identity *out = NULL;
+
+    cache->insert(fake_vtable(4), &a);
+    cache->invalidate(fake_vtable(4));
+    EXPECT_FALSE(cache->find(fake_vtable(4), &out));
+    cache->invalidate(fake_vtable(5));
+    EXPECT_FALSE(cache->find(fake_vtable(5), &out));
+
+    cache->insert(fake_vtable(4), &b);
+    ASSERT_TRUE(cache->find(fake_vtable(4), &out));
+    EXPECT_EQ(out, &b);
+}
+
+TEST(VTableCache, probe_window_full) {
+    typedef VTableCache<Identity> Cache;
+    auto cache = std::make_unique<Cache>();
+    auto vtables = colliding_vtables(Cache::MAX_PROBES + 1);
+    std::vector<Identity> ids(vtables.size());
+    Identity *out = NULL;
+
+    for (size_t i = 0; i < vtables.size(); i++)
+        cache->insert(vtables[i], &ids[i]);
+
+    for (size_t i = 0; i < Cache::MAX_PROBES; i++) {
+        ASSERT_TRUE(cache->find(vtables[i], &out));
+        EXPECT_EQ(out, &ids[i]);
+    }
+    EXPECT_FALSE(cache->find(vtables.back(), &out));
+}
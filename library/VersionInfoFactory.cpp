@@ -27,6 +27,9 @@ distribution.
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <map>
 #include <iostream>
 
@@ -36,6 +39,9 @@ distribution.
 #include "Memory.h"
 #include "MemAccess.h"
 #include "PluginManager.h"
+#include "DFHackVersion.h"
+#include "MiscUtils.h"
+#include "modules/Filesystem.h"
 
 #include <tinyxml.h>
 
@@ -118,10 +124,29 @@ static uintptr_t get_addr(const char * cstr_value, const char * cstr_base,
     return addr;
 }
 
-void VersionInfoFactory::ParseVersion (TiXmlElement* entry, VersionInfo* mem)
+// One address entry of a symbol table, as written in symbols.xml. Addresses
+// can depend on where DF was mapped, so they are only resolved in addVersions.
+struct SymbolEntry
+{
+    bool is_vtable = false;
+    std::string name;
+    std::string value;
+    std::string base;
+    std::string mangled;
+    std::string offset;
+};
+
+struct VersionInfoFactory::SymbolTable
+{
+    std::string name;
+    OSType os = OS_BAD;
+    std::vector<std::string> md5s;
+    std::vector<uintptr_t> pe_stamps;
+    std::vector<SymbolEntry> entries;
+};
+
+void VersionInfoFactory::ParseVersion (TiXmlElement* entry, SymbolTable &table)
 {
-    bool no_vtables = getenv("DFHACK_NO_VTABLES");
-    bool no_globals = getenv("DFHACK_NO_GLOBALS");
     TiXmlElement* pMemEntry;
     const char *cstr_name = entry->Attribute("name");
     if (!cstr_name)
@@ -132,25 +157,24 @@ void VersionInfoFactory::ParseVersion (TiXmlElement* entry, VersionInfo* mem)
         throw Error::SymbolsXmlBadAttribute("os-type");
 
     string os = cstr_os;
-    mem->setVersion(cstr_name);
+    table.name = cstr_name;
 
     if(os == "windows")
     {
-        mem->setOS(OS_WINDOWS);
+        table.os = OS_WINDOWS;
     }
     else if(os == "linux")
     {
-        mem->setOS(OS_LINUX);
+        table.os = OS_LINUX;
     }
     else if(os == "darwin")
     {
-        mem->setOS(OS_APPLE);
+        table.os = OS_APPLE;
     }
     else
     {
         return; // ignore it if it's invalid
     }
-    mem->setBase(DEFAULT_BASE_ADDR);  // Memory.h
 
     // process additional entries
     //cout << "Entry " << cstr_version << " " <<  cstr_os << endl;
@@ -158,8 +182,6 @@ void VersionInfoFactory::ParseVersion (TiXmlElement* entry, VersionInfo* mem)
         cerr << "Empty symbol table: " << entry->Attribute("name") << endl;
         return;
     }
-    std::vector<DFHack::t_memrange> ranges;
-    Core::getInstance().p->getMemRanges(ranges);
     pMemEntry = entry->FirstChildElement()->ToElement();
     for(;pMemEntry;pMemEntry=pMemEntry->NextSiblingElement())
     {
@@ -180,48 +202,278 @@ void VersionInfoFactory::ParseVersion (TiXmlElement* entry, VersionInfo* mem)
                 cerr << "Dummy symbol table entry: " << cstr_key << endl;
                 continue;
             }
-            if ((is_vtable && no_vtables) || (!is_vtable && no_globals))
-                continue;
-            uintptr_t addr;
-            if (cstr_value) {
-                addr = get_addr(cstr_value, cstr_base, ranges);
-            } else {
-                addr = (uintptr_t)DFHack::LookupPlugin(DFHack::GLOBAL_NAMES, cstr_mangled);
-                if (!addr)
-                    continue;
-                const char *cstr_offset = pMemEntry->Attribute("offset");
-                if (cstr_offset) {
-                    unsigned long offset = strtoul(cstr_offset, 0, 0);
-                    addr += offset;
-                }
+            SymbolEntry sym;
+            sym.is_vtable = is_vtable;
+            sym.name = cstr_key;
+            if (cstr_value)
+            {
+                sym.value = cstr_value;
+                if (cstr_base)
+                    sym.base = cstr_base;
             }
-            if (is_vtable)
-                mem->setVTable(cstr_key, addr);
             else
-                mem->setAddress(cstr_key, addr);
+            {
+                sym.mangled = cstr_mangled;
+                if (const char *cstr_offset = pMemEntry->Attribute("offset"))
+                    sym.offset = cstr_offset;
+            }
+            table.entries.push_back(std::move(sym));
         }
         else if (type == "md5-hash")
         {
             const char *cstr_value = pMemEntry->Attribute("value");
-            fprintf(stderr, "%s (%s): MD5: %s\n", cstr_name, cstr_os, cstr_value);
             if(!cstr_value)
                 throw Error::SymbolsXmlUnderspecifiedEntry(cstr_name);
-            mem->addMD5(cstr_value);
+            table.md5s.push_back(cstr_value);
         }
         else if (type == "binary-timestamp")
         {
             const char *cstr_value = pMemEntry->Attribute("value");
-            fprintf(stderr, "%s (%s): PE: %s\n", cstr_name, cstr_os, cstr_value);
             if(!cstr_value)
                 throw Error::SymbolsXmlUnderspecifiedEntry(cstr_name);
-            mem->addPE(strtol(cstr_value, 0, 16));
+            table.pe_stamps.push_back(strtol(cstr_value, 0, 16));
         }
     } // for
 } // method
 
+// resolve the addresses in the symbol tables and make VersionInfos out of them
+void VersionInfoFactory::addVersions(const std::vector<SymbolTable> &tables)
+{
+    static const char *os_names[] = { "windows", "linux", "darwin" };
+    bool no_vtables = getenv("DFHACK_NO_VTABLES");
+    bool no_globals = getenv("DFHACK_NO_GLOBALS");
+    std::vector<DFHack::t_memrange> ranges;
+    Core::getInstance().p->getMemRanges(ranges);
+
+    for (auto &table : tables)
+    {
+        auto mem = std::make_shared<VersionInfo>();
+        mem->setVersion(table.name);
+        versions.push_back(mem);
+        if (table.os == OS_BAD)
+            continue;
+        mem->setOS(table.os);
+        mem->setBase(DEFAULT_BASE_ADDR);  // Memory.h
+
+        const char *cstr_os = os_names[table.os];
+        for (auto &md5 : table.md5s)
+        {
+            fprintf(stderr, "%s (%s): MD5: %s\n", table.name.c_str(), cstr_os, md5.c_str());
+            mem->addMD5(md5);
+        }
+        for (auto pe : table.pe_stamps)
+        {
+            fprintf(stderr, "%s (%s): PE: %zx\n", table.name.c_str(), cstr_os, (size_t)pe);
+            mem->addPE(pe);
+        }
+        for (auto &sym : table.entries)
+        {
+            if ((sym.is_vtable && no_vtables) || (!sym.is_vtable && no_globals))
+                continue;
+            uintptr_t addr;
+            if (!sym.value.empty()) {
+                addr = get_addr(sym.value.c_str(), sym.base.empty() ? NULL : sym.base.c_str(), ranges);
+            } else {
+                addr = (uintptr_t)DFHack::LookupPlugin(DFHack::GLOBAL_NAMES, sym.mangled.c_str());
+                if (!addr)
+                    continue;
+                if (!sym.offset.empty())
+                    addr += strtoul(sym.offset.c_str(), 0, 0);
+            }
+            if (sym.is_vtable)
+                mem->setVTable(sym.name, addr);
+            else
+                mem->setAddress(sym.name, addr);
+        }
+    }
+}
+
+/*
+ * Binary cache of the parsed symbol tables. The layout is the in-memory
+ * representation of this build (native endianness and pointer size), since
+ * the cache is never shared between installs:
+ *
+ *   "DFHS" u32:format stamp u32:table_count tables...
+ *
+ * where strings are u32 length + bytes and each table is
+ *   name u8:os u32:n md5s... u32:n u64:pe... u32:n entries...
+ * and each entry is u8:is_vtable name value base mangled offset.
+ */
+
+static const char SYMBOL_CACHE_MAGIC[4] = {'D', 'F', 'H', 'S'};
+static const uint32_t SYMBOL_CACHE_FORMAT = 1;
+
+namespace {
+    struct CacheWriter {
+        std::string data;
+
+        void put_u8(uint8_t val) { data.push_back((char)val); }
+        void put_u32(uint32_t val) { data.append((const char *)&val, sizeof(val)); }
+        void put_u64(uint64_t val) { data.append((const char *)&val, sizeof(val)); }
+        void put_str(const std::string &val) { put_u32(val.size()); data.append(val); }
+    };
+
+    struct CacheReader {
+        const std::string &data;
+        size_t pos = 0;
+        bool ok = true;
+
+        CacheReader(const std::string &data) : data(data) {}
+
+        bool has(size_t size) {
+            ok = ok && size <= data.size() - pos;
+            return ok;
+        }
+        template<typename T>
+        T get() {
+            T val = 0;
+            if (has(sizeof(T))) {
+                memcpy(&val, data.data() + pos, sizeof(T));
+                pos += sizeof(T);
+            }
+            return val;
+        }
+        std::string get_str() {
+            uint32_t size = get<uint32_t>();
+            if (!has(size))
+                return std::string();
+            pos += size;
+            return data.substr(pos - size, size);
+        }
+        // element counts are bounded by the remaining bytes, so a corrupt
+        // count cannot trigger a huge allocation
+        uint32_t get_count() {
+            uint32_t count = get<uint32_t>();
+            return has(count) ? count : 0;
+        }
+    };
+}
+
+bool VersionInfoFactory::readCache(const string &path, const string &stamp, std::vector<SymbolTable> &tables)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    CacheReader in(data);
+    if (!in.has(sizeof(SYMBOL_CACHE_MAGIC)) || memcmp(data.data(), SYMBOL_CACHE_MAGIC, sizeof(SYMBOL_CACHE_MAGIC)))
+        return false;
+    in.pos += sizeof(SYMBOL_CACHE_MAGIC);
+    if (in.get<uint32_t>() != SYMBOL_CACHE_FORMAT || in.get_str() != stamp)
+        return false;
+
+    tables.resize(in.get_count());
+    for (auto &table : tables)
+    {
+        table.name = in.get_str();
+        table.os = (OSType)in.get<uint8_t>();
+        if (table.os > OS_BAD)
+            in.ok = false;
+        table.md5s.resize(in.get_count());
+        for (auto &md5 : table.md5s)
+            md5 = in.get_str();
+        table.pe_stamps.resize(in.get_count());
+        for (auto &pe : table.pe_stamps)
+            pe = (uintptr_t)in.get<uint64_t>();
+        table.entries.resize(in.get_count());
+        for (auto &sym : table.entries)
+        {
+            sym.is_vtable = in.get<uint8_t>() != 0;
+            sym.name = in.get_str();
+            sym.value = in.get_str();
+            sym.base = in.get_str();
+            sym.mangled = in.get_str();
+            sym.offset = in.get_str();
+        }
+        if (!in.ok)
+            break;
+    }
+
+    if (!in.ok || in.pos != data.size())
+    {
+        cerr << "Ignoring corrupt symbol cache: " << path << endl;
+        tables.clear();
+        return false;
+    }
+    return true;
+}
+
+void VersionInfoFactory::writeCache(const string &path, const string &stamp, const std::vector<SymbolTable> &tables)
+{
+    CacheWriter out;
+    out.data.append(SYMBOL_CACHE_MAGIC, sizeof(SYMBOL_CACHE_MAGIC));
+    out.put_u32(SYMBOL_CACHE_FORMAT);
+    out.put_str(stamp);
+    out.put_u32(tables.size());
+    for (auto &table : tables)
+    {
+        out.put_str(table.name);
+        out.put_u8(table.os);
+        out.put_u32(table.md5s.size());
+        for (auto &md5 : table.md5s)
+            out.put_str(md5);
+        out.put_u32(table.pe_stamps.size());
+        for (auto pe : table.pe_stamps)
+            out.put_u64(pe);
+        out.put_u32(table.entries.size());
+        for (auto &sym : table.entries)
+        {
+            out.put_u8(sym.is_vtable);
+            out.put_str(sym.name);
+            out.put_str(sym.value);
+            out.put_str(sym.base);
+            out.put_str(sym.mangled);
+            out.put_str(sym.offset);
+        }
+    }
+
+    // write to a temporary file first so a crash cannot leave a truncated
+    // cache behind that matches the stamp
+    string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        file.write(out.data.data(), out.data.size());
+        if (!file.flush())
+        {
+            cerr << "Could not write symbol cache: " << tmp_path << endl;
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec)
+    {
+        cerr << "Could not write symbol cache: " << path << ": " << ec.message() << endl;
+        std::filesystem::remove(tmp_path, ec);
+    }
+}
+
 // load the XML file with offsets
 bool VersionInfoFactory::loadFile(string path_to_xml)
 {
+    return loadFileCached(path_to_xml, "");
+}
+
+bool VersionInfoFactory::loadFileCached(string path_to_xml, string path_to_cache)
+{
+    // the cache is only valid for this exact symbols.xml and DFHack build
+    string stamp;
+    STAT_STRUCT info;
+    if (!path_to_cache.empty() && Filesystem::stat(path_to_xml, info))
+        stamp = stl_sprintf("%lld:%lld:%s", (long long)info.st_mtime,
+            (long long)info.st_size, Version::git_description());
+
+    std::vector<SymbolTable> tables;
+    if (!stamp.empty() && readCache(path_to_cache, stamp, tables))
+    {
+        std::cerr << "Loaded " << path_to_xml << " from " << path_to_cache << std::endl;
+        clear();
+        addVersions(tables);
+        std::cerr << "Loaded " << versions.size() << " DF symbol tables." << std::endl;
+        return true;
+    }
+
     TiXmlDocument doc( path_to_xml.c_str() );
     std::cerr << "Loading " << path_to_xml << " ... ";
     //bool loadOkay = doc.LoadFile();
@@ -267,13 +519,24 @@ bool VersionInfoFactory::loadFile(string path_to_xml)
             const char *name = pMemInfo->Attribute("name");
             if(name)
             {
-                auto version = std::make_shared<VersionInfo>();
-                ParseVersion( pMemInfo , version.get() );
-                versions.push_back(version);
+                tables.emplace_back();
+                ParseVersion( pMemInfo , tables.back() );
             }
         }
+        addVersions(tables);
     }
     error = false;
+    if (!stamp.empty())
+    {
+        static const OSType cur_os = VersionInfo::getCurOS();
+        std::vector<SymbolTable> cur_os_tables;
+        for (auto &table : tables)
+        {
+            if (table.os == cur_os)
+                cur_os_tables.push_back(table);
+        }
+        writeCache(path_to_cache, stamp, cur_os_tables);
+    }
     std::cerr << "Loaded " << versions.size() << " DF symbol tables." << std::endl;
     return true;
 }
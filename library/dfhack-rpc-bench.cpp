@@ -0,0 +1,161 @@
+// Load test for the RPC server of a running DFHack instance.
+//
+// Usage: dfhack-rpc-bench [-c clients] [-t seconds] [-r] [command [args...]]
+//
+// Each client thread calls GetVersion (or runs the given command) in a loop
+// and the total requests per second and the latency distribution are
+// reported at the end. With -r, every request opens a new connection, like
+// dfhack-run does. The port is taken from DFHACK_PORT, as for dfhack-run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RemoteClient.h"
+
+using namespace DFHack;
+using namespace dfproto;
+
+typedef std::chrono::steady_clock bench_clock;
+
+namespace {
+    // text sent back by the server is not interesting here
+    class null_ostream : public color_ostream {
+    protected:
+        void add_text(color_value, const std::string &) override {}
+    };
+
+    struct Options {
+        int clients = 8;
+        int seconds = 10;
+        bool reconnect = false;
+        std::string command;
+        std::vector<std::string> args;
+    };
+
+    struct ClientStats {
+        size_t failures = 0;
+        std::vector<double> latency_ms;
+    };
+
+    void client_loop(const Options &opts, const std::atomic<bool> &stop, ClientStats &stats)
+    {
+        null_ostream out;
+        std::unique_ptr<RemoteClient> client;
+        std::unique_ptr<RemoteFunction<EmptyMessage, StringMessage>> get_version;
+
+        while (!stop)
+        {
+            auto start = bench_clock::now();
+            bool ok = true;
+
+            if (!client)
+            {
+                client.reset(new RemoteClient(&out));
+                get_version.reset(new RemoteFunction<EmptyMessage, StringMessage>());
+                ok = client->connect() &&
+                     (!opts.command.empty() || get_version->bind(client.get(), "GetVersion"));
+            }
+
+            if (ok)
+            {
+                if (opts.command.empty())
+                    ok = (*get_version)(out) == CR_OK;
+                else
+                    ok = client->run_command(out, opts.command, opts.args) == CR_OK;
+            }
+
+            if (!ok || opts.reconnect)
+            {
+                get_version.reset();
+                client.reset();
+            }
+
+            auto elapsed = std::chrono::duration<double, std::milli>(bench_clock::now() - start);
+            if (ok)
+                stats.latency_ms.push_back(elapsed.count());
+            else
+            {
+                stats.failures++;
+                // don't spin if the server is not there
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        size_t idx = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+        return sorted[idx];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options opts;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            opts.clients = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            opts.seconds = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-r"))
+            opts.reconnect = true;
+        else
+        {
+            fprintf(stderr, "Usage: dfhack-rpc-bench [-c clients] [-t seconds] [-r] [command [args...]]\n");
+            return 2;
+        }
+    }
+    if (i < argc)
+        opts.command = argv[i++];
+    for (; i < argc; i++)
+        opts.args.push_back(argv[i]);
+
+    printf("%d clients, %d seconds, %s connections, calling %s\n",
+           opts.clients, opts.seconds, opts.reconnect ? "per-request" : "persistent",
+           opts.command.empty() ? "GetVersion" : opts.command.c_str());
+
+    std::atomic<bool> stop(false);
+    std::vector<ClientStats> stats(opts.clients);
+    std::vector<std::thread> threads;
+
+    auto start = bench_clock::now();
+    for (int c = 0; c < opts.clients; c++)
+        threads.emplace_back(client_loop, std::cref(opts), std::cref(stop), std::ref(stats[c]));
+
+    std::this_thread::sleep_for(std::chrono::seconds(opts.seconds));
+    stop = true;
+    for (auto &thread : threads)
+        thread.join();
+    double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::vector<double> latency;
+    size_t failures = 0;
+    for (auto &s : stats)
+    {
+        latency.insert(latency.end(), s.latency_ms.begin(), s.latency_ms.end());
+        failures += s.failures;
+    }
+    std::sort(latency.begin(), latency.end());
+
+    printf("%zu requests, %zu failed, %.1f requests/s\n",
+           latency.size(), failures, latency.size() / elapsed);
+    printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+           percentile(latency, 0.5), percentile(latency, 0.9),
+           percentile(latency, 0.99), latency.empty() ? 0 : latency.back());
+
+    return failures ? 1 : 0;
+}
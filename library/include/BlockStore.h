@@ -0,0 +1,136 @@
+#pragma once
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace DFHack
+{
+    /**
+     * Storage for lazily created per-map-block objects.
+     *
+     * Lookup goes through a flat index over block coordinates; the index for
+     * each z level is only allocated when a block on that level is created.
+     * The objects themselves live in an arena of fixed-size chunks, reused
+     * through a free list when erased and released all at once by clear().
+     */
+    template<typename T, size_t ChunkSize = 64>
+    class BlockStore
+    {
+    public:
+        BlockStore() {}
+        BlockStore(uint32_t x_size, uint32_t y_size, uint32_t z_size) {
+            resize(x_size, y_size, z_size);
+        }
+        ~BlockStore() { clear(); }
+
+        BlockStore(const BlockStore &) = delete;
+        BlockStore &operator=(const BlockStore &) = delete;
+
+        /// Destroy all objects and set new bounds.
+        void resize(uint32_t x_size, uint32_t y_size, uint32_t z_size) {
+            clear();
+            x_max = x_size;
+            y_max = y_size;
+            levels.clear();
+            levels.resize(z_size);
+        }
+
+        bool inBounds(int32_t x, int32_t y, int32_t z) const {
+            return uint32_t(x) < x_max && uint32_t(y) < y_max && uint32_t(z) < levels.size();
+        }
+
+        T *find(int32_t x, int32_t y, int32_t z) const {
+            if (!inBounds(x, y, z) || !levels[z])
+                return NULL;
+            return levels[z][y * x_max + x];
+        }
+
+        /// Construct an object at the coordinates. Returns NULL if they are
+        /// out of bounds; returns the existing object if one is already there.
+        template<typename... Args>
+        T *emplace(int32_t x, int32_t y, int32_t z, Args&&... args) {
+            if (!inBounds(x, y, z))
+                return NULL;
+            auto &level = levels[z];
+            if (!level)
+                level.reset(new T*[x_max * y_max]());
+            T *&entry = level[y * x_max + x];
+            if (!entry) {
+                void *slot = allocate();
+                entry = new (slot) T(std::forward<Args>(args)...);
+                count++;
+            }
+            return entry;
+        }
+
+        /// Destroy the object at the coordinates, if any.
+        void erase(int32_t x, int32_t y, int32_t z) {
+            if (!inBounds(x, y, z) || !levels[z])
+                return;
+            T *&entry = levels[z][y * x_max + x];
+            if (!entry)
+                return;
+            entry->~T();
+            free_slots.push_back(entry);
+            entry = NULL;
+            count--;
+        }
+
+        /// Call fn(T*) for every object, in z, y, x order.
+        template<typename F>
+        void for_each(F fn) const {
+            size_t level_size = size_t(x_max) * y_max;
+            for (auto &level : levels) {
+                if (!level)
+                    continue;
+                for (size_t i = 0; i < level_size; i++) {
+                    if (level[i])
+                        fn(level[i]);
+                }
+            }
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        /// Destroy all objects and release the arena. Bounds are kept.
+        void clear() {
+            for_each([](T *obj) { obj->~T(); });
+            for (auto &level : levels)
+                level.reset();
+            chunks.clear();
+            free_slots.clear();
+            chunk_used = ChunkSize;
+            count = 0;
+        }
+
+    private:
+        struct Slot {
+            alignas(T) unsigned char data[sizeof(T)];
+        };
+
+        uint32_t x_max = 0;
+        uint32_t y_max = 0;
+        std::vector<std::unique_ptr<T*[]>> levels;
+        std::vector<std::unique_ptr<Slot[]>> chunks;
+        std::vector<void*> free_slots;
+        size_t chunk_used = ChunkSize;
+        size_t count = 0;
+
+        void *allocate() {
+            if (!free_slots.empty()) {
+                void *slot = free_slots.back();
+                free_slots.pop_back();
+                return slot;
+            }
+            if (chunk_used == ChunkSize) {
+                chunks.emplace_back(new Slot[ChunkSize]);
+                chunk_used = 0;
+            }
+            return chunks.back()[chunk_used++].data;
+        }
+    };
+}
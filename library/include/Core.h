@@ -36,6 +36,7 @@ distribution.
 #include <memory>
 #include <mutex>
 #include <stack>
+#include <string>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
@@ -61,6 +62,7 @@ namespace DFHack
     struct VersionInfo;
     class VersionInfoFactory;
     class PluginManager;
+    class Plugin;
     class Core;
     class ServerMain;
     class CoreSuspender;
@@ -112,8 +114,9 @@ namespace DFHack
         uint32_t total_overlay_ms;
         std::unordered_map<int32_t, uint32_t> event_manager_event_total_ms;
         std::unordered_map<int32_t, std::unordered_map<std::string, uint32_t>> event_manager_event_per_plugin_ms;
-        std::unordered_map<std::string, uint32_t> update_per_plugin;
-        std::unordered_map<std::string, uint32_t> state_change_per_plugin;
+        // indexed by Plugin::getPerfSlot()
+        std::vector<uint32_t> update_per_plugin;
+        std::vector<uint32_t> state_change_per_plugin;
         std::unordered_map<std::string, uint32_t> update_lua_per_repeat;
         std::unordered_map<std::string, uint32_t> overlay_per_widget;
         std::unordered_map<std::string, uint32_t> zscreen_per_focus;
@@ -141,6 +144,110 @@ namespace DFHack
         } recent_ticks;
     };
 
+    // Nested-scope tracing profiler with microsecond resolution. Completed
+    // scopes go into a ring buffer and a per-(category, name) window of recent
+    // durations for percentile reporting. Does nothing until started.
+    // Scopes are keyed by pointer, so names must be string literals, interned
+    // names or plugins (identified by their perf slot).
+    class DFHACK_EXPORT FrameProfiler
+    {
+    public:
+        static const size_t DEFAULT_CAPACITY = 1 << 16;
+        static const size_t SAMPLE_WINDOW = 1024;
+        static const size_t NO_SLOT = size_t(-1);
+
+        struct Event {
+            const char *category;
+            const char *name; // NULL for plugin scopes
+            size_t slot;
+            uint64_t start_us;
+            uint32_t duration_us;
+            uint32_t frame;
+            uint16_t depth;
+        };
+
+        struct Stats {
+            std::string category;
+            std::string name;
+            size_t count;
+            uint64_t total_us;
+            uint32_t p50_us;
+            uint32_t p99_us;
+            uint32_t max_us;
+        };
+
+        // RAII scope; category must be a string literal
+        class DFHACK_EXPORT Scope
+        {
+        public:
+            // name must be a string literal
+            Scope(FrameProfiler &profiler, const char *category, const char *name);
+            Scope(FrameProfiler &profiler, const char *category, const Plugin *plugin);
+            // the name is interned when profiling, so prefer the other forms on hot paths
+            Scope(FrameProfiler &profiler, const char *category, const std::string &name);
+            ~Scope();
+        private:
+            FrameProfiler *profiler;
+            const char *category;
+            const char *name;
+            size_t slot;
+            uint64_t start_us;
+        };
+
+        void start(size_t capacity = DEFAULT_CAPACITY);
+        void stop();
+        void reset();
+        bool isEnabled() const { return enabled; }
+        void beginFrame() { if (enabled) ++frame; }
+
+        size_t getEventCount() const { return count; }
+        uint32_t getFrameCount() const { return frame; }
+        // sorted by descending total time
+        void getStats(std::vector<Stats> *out) const;
+        bool exportChromeTrace(std::ostream &out) const;
+
+    private:
+        struct Key {
+            const char *category;
+            const char *name;
+            size_t slot;
+            bool operator==(const Key &other) const {
+                return category == other.category && name == other.name && slot == other.slot;
+            }
+        };
+        struct KeyHash {
+            size_t operator()(const Key &key) const {
+                size_t h = std::hash<const void*>()(key.category);
+                h = h * 31 + std::hash<const void*>()(key.name);
+                return h * 31 + key.slot;
+            }
+        };
+        struct Samples {
+            std::vector<uint32_t> window;
+            size_t head = 0;
+            size_t count = 0;
+            uint64_t total_us = 0;
+            uint32_t max_us = 0;
+        };
+
+        bool enabled = false;
+        uint16_t depth = 0;
+        uint32_t frame = 0;
+        uint64_t epoch_us = 0;
+        std::vector<Event> events;
+        size_t head = 0;
+        size_t count = 0;
+        std::unordered_map<Key, Samples, KeyHash> samples;
+        // never cleared, so open scopes and buffered events stay valid
+        std::unordered_set<std::string> names;
+
+        static uint64_t now_us();
+        static std::vector<std::string> pluginNames();
+        static std::string scopeName(const char *name, size_t slot,
+                                     const std::vector<std::string> &plugin_names);
+        void record(const Key &key, uint64_t start_us, uint64_t end_us);
+    };
+
     class DFHACK_EXPORT StateChangeScript
     {
     public:
@@ -241,6 +348,7 @@ namespace DFHack
         static void cheap_tokenise(std::string const& input, std::vector<std::string> &output);
 
         PerfCounters perf_counters;
+        FrameProfiler frame_profiler;
 
     private:
         DFHack::Console con;
@@ -137,6 +137,9 @@ namespace DFHack
 
         int lua_item_count(lua_State *state, void *ptr, CountMode cnt) const;
 
+        int getItemCount(void *ptr) const { return item_count(ptr, COUNT_LEN); }
+        void *getItemPointer(void *ptr, int idx) const { return item_pointer(item, ptr, idx); }
+
         virtual void lua_item_reference(lua_State *state, int fname_idx, void *ptr, int idx) const;
         virtual void lua_item_read(lua_State *state, int fname_idx, void *ptr, int idx) const;
         virtual void lua_item_write(lua_State *state, int fname_idx, void *ptr, int idx, int val_index) const;
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace DFHack
+{
+    /**
+     * Ordered multimap from string keys to values.
+     *
+     * Each distinct key is stored once and can be referenced by the values
+     * (see intern()); the values for a key are kept contiguously in
+     * insertion order. Iteration is in key order, then insertion order,
+     * like std::multimap, but lookups cost one search per distinct key and
+     * visiting values does not copy them.
+     */
+    template<typename T>
+    class KeyIndex
+    {
+        typedef std::vector<T> Bucket;
+        typedef std::map<std::string_view, Bucket> BucketMap;
+
+    public:
+        KeyIndex() {}
+        KeyIndex(const KeyIndex &) = delete;
+        KeyIndex &operator=(const KeyIndex &) = delete;
+
+        /// Returns the stored copy of the key. It stays valid, even if all
+        /// values for the key are erased, until the index is destroyed.
+        const std::string &intern(const std::string &key) {
+            return *keys.insert(key).first;
+        }
+
+        void add(const std::string &key, T value) {
+            buckets[intern(key)].push_back(std::move(value));
+            count++;
+        }
+
+        /// Erase the first value for the key that satisfies pred.
+        template<typename P>
+        bool erase_if(const std::string &key, P pred) {
+            auto it = buckets.find(key);
+            if (it == buckets.end())
+                return false;
+            Bucket &bucket = it->second;
+            for (auto vit = bucket.begin(); vit != bucket.end(); ++vit) {
+                if (!pred(*vit))
+                    continue;
+                bucket.erase(vit);
+                if (bucket.empty())
+                    buckets.erase(it);
+                count--;
+                return true;
+            }
+            return false;
+        }
+
+        /// Returns the first value for the key, or NULL.
+        const T *find(const std::string &key) const {
+            auto it = buckets.find(key);
+            return it == buckets.end() ? NULL : &it->second.front();
+        }
+
+        size_t count_key(const std::string &key) const {
+            auto it = buckets.find(key);
+            return it == buckets.end() ? 0 : it->second.size();
+        }
+
+        /// Call fn(const T&) for every value.
+        template<typename F>
+        void for_each(F fn) const {
+            for (auto &entry : buckets)
+                for (auto &value : entry.second)
+                    fn(value);
+        }
+
+        /// Call fn(const T&) for every value with the given key.
+        template<typename F>
+        void for_each_key(const std::string &key, F fn) const {
+            auto it = buckets.find(key);
+            if (it == buckets.end())
+                return;
+            for (auto &value : it->second)
+                fn(value);
+        }
+
+        /// Call fn(const T&) for every value with min <= key < max.
+        template<typename F>
+        void for_each_range(const std::string &min, const std::string &max, F fn) const {
+            if (!(min < max))
+                return;
+            auto end = buckets.lower_bound(max);
+            for (auto it = buckets.lower_bound(min); it != end; ++it)
+                for (auto &value : it->second)
+                    fn(value);
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        void clear() {
+            buckets.clear();
+            keys.clear();
+            count = 0;
+        }
+
+    private:
+        std::unordered_set<std::string> keys;
+        BucketMap buckets;
+        size_t count = 0;
+    };
+}
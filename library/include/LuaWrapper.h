@@ -166,6 +166,11 @@ namespace LuaWrapper {
                                        const char *ctx, bool allow_type = false,
                                        bool keep_metatable = false);
 
+    /**
+     * Implementation of df.extract(container, fields).
+     */
+    int bulk_extract(lua_State *state);
+
     void LookupInTable(lua_State *state, void *id, LuaToken *tname);
     void SaveInTable(lua_State *state, void *node, LuaToken *tname);
     void SaveTypeInfo(lua_State *state, void *node);
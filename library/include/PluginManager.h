@@ -152,6 +152,11 @@ namespace DFHack
         command_result load_world_data(color_ostream &out);
         command_result load_site_data(color_ostream &out);
         void detach_connection(RPCService *svc);
+        // the steps of load(), split up so PluginManager::init can open
+        // libraries concurrently
+        bool begin_load(color_ostream &out);
+        bool open_library(color_ostream &out);
+        bool init_library(color_ostream &out);
     public:
         enum plugin_state
         {
@@ -190,6 +195,11 @@ namespace DFHack
         {
             return name;
         }
+        // index of this plugin's entries in the per-plugin PerfCounters vectors
+        size_t getPerfSlot() const
+        {
+            return perf_slot;
+        }
         plugin_state getState()
         {
             return state;
@@ -203,6 +213,7 @@ namespace DFHack
         std::vector <RPCService*> services;
         std::string path;
         std::string name;
+        size_t perf_slot;
         DFLibrary * plugin_lib;
         PluginManager * parent;
         plugin_state state;
@@ -247,6 +258,7 @@ namespace DFHack
         PluginManager(Core * core);
         ~PluginManager();
         void init();
+        bool loadAllParallel(size_t threads);
         void OnUpdate(color_ostream &out);
         void OnStateChange(color_ostream &out, state_change_event event);
         void registerCommands( Plugin * p );
@@ -254,6 +266,8 @@ namespace DFHack
         void doSaveData(color_ostream &out);
         void doLoadWorldData(color_ostream &out);
         void doLoadSiteData(color_ostream &out);
+        void addDispatch(Plugin *p);
+        void removeDispatch(Plugin *p);
     // PUBLIC METHODS
     public:
         // list names of all plugins present in hack/plugins
@@ -286,6 +300,12 @@ namespace DFHack
         std::map <std::string, Plugin*> command_map;
         std::map <std::string, Plugin*> all_plugins;
         std::string plugin_path;
+        // Loaded plugins that export the corresponding hooks, in name order.
+        // Only modified while the core is suspended.
+        std::vector<Plugin*> update_dispatch;
+        std::vector<Plugin*> state_change_dispatch;
+        std::vector<Plugin*> save_dispatch;
+        std::vector<Plugin*> load_dispatch;
     };
 
     namespace Gui
@@ -27,7 +27,12 @@ distribution.
 #include "RemoteClient.h"
 #include "Core.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
 
 class CPassiveSocket;
 class CActiveSocket;
@@ -38,6 +43,7 @@ namespace  DFHack
     class Plugin;
     class CoreService;
     class ServerConnection;
+    struct ServerMainImpl;
 
     class DFHACK_EXPORT RPCService;
 
@@ -60,6 +66,9 @@ namespace  DFHack
 
         virtual command_result execute(color_ostream &stream) = 0;
 
+        // Called after a successful execute(), without the core suspended.
+        virtual command_result finish(color_ostream &stream) { return CR_OK; }
+
         int16_t getId() { return id; }
 
     protected:
@@ -93,6 +102,43 @@ namespace  DFHack
         function_type fptr;
     };
 
+    /*
+     * A function split into two phases: snapshot runs with the core suspended
+     * (unless SF_DONT_SUSPEND is set) and should only copy the raw data it
+     * needs into the staging object; build then runs with the core running and
+     * turns the staged data into the reply message. This keeps the game from
+     * being suspended while large replies are constructed.
+     */
+    template<typename In, typename Stage, typename Out>
+    class StagedServerFunction : public ServerFunctionBase {
+    public:
+        typedef command_result (*snapshot_type)(color_ostream &out, const In *input, Stage *stage);
+        typedef command_result (*build_type)(color_ostream &out, const In *input, const Stage *stage, Out *output);
+
+        In *in() { return static_cast<In*>(RPCFunctionBase::in()); }
+        Out *out() { return static_cast<Out*>(RPCFunctionBase::out()); }
+
+        StagedServerFunction(RPCService *owner, const char *name, int flags, snapshot_type snapshot, build_type build)
+            : ServerFunctionBase(&In::default_instance(), &Out::default_instance(), owner, name, flags),
+              snapshot(snapshot), build(build) {}
+
+        virtual command_result execute(color_ostream &stream) {
+            stage = Stage();
+            return snapshot(stream, in(), &stage);
+        }
+
+        virtual command_result finish(color_ostream &stream) {
+            command_result res = build(stream, in(), &stage, out());
+            stage = Stage();
+            return res;
+        }
+
+    private:
+        snapshot_type snapshot;
+        build_type build;
+        Stage stage;
+    };
+
     template<typename In>
     class VoidServerFunction : public ServerFunctionBase {
     public:
@@ -188,6 +234,17 @@ namespace  DFHack
             functions.push_back(new VoidServerFunction<In>(this, name, flags, fptr));
         }
 
+        template<typename In, typename Stage, typename Out>
+        void addStagedFunction(
+            const char *name,
+            command_result (*snapshot)(color_ostream &out, const In *input, Stage *stage),
+            command_result (*build)(color_ostream &out, const In *input, const Stage *stage, Out *output),
+            int flags = 0
+        ) {
+            assert(!owner);
+            functions.push_back(new StagedServerFunction<In,Stage,Out>(this, name, flags, snapshot, build));
+        }
+
     protected:
         ServerConnection *connection() { return owner; }
 
@@ -225,7 +282,9 @@ namespace  DFHack
             connection_ostream(ServerConnection *owner) : owner(owner) {}
         };
 
-        bool in_error;
+        friend struct ServerMainImpl;
+
+        std::atomic<bool> in_error;
         CActiveSocket *socket;
         connection_ostream stream;
 
@@ -234,22 +293,39 @@ namespace  DFHack
         CoreService *core_service;
         std::map<std::string, RPCService*> plugin_services;
 
-        void threadFn();
-        ServerConnection(CActiveSocket* socket);
+        // Socket I/O is done by the server's event loop; requests run on the
+        // worker thread the connection was assigned when it was accepted.
+        // The input buffer and flags belong to the event loop, the output
+        // buffer is shared with the worker under output_mutex.
+        ServerMainImpl *server;
+        size_t worker;
+        std::string input;
+        bool handshake_done;
+        bool busy;
+        bool closing;
+
+        std::mutex output_mutex;
+        std::condition_variable output_drained;
+        std::string output;
+
+        ServerConnection(ServerMainImpl *server, CActiveSocket* socket, size_t worker);
         ~ServerConnection();
 
-    public:
-
-        static void Accepted(CActiveSocket* socket);
+        void handleRequest(int16_t id, const uint8_t *data, int size);
+        bool sendMessage(int16_t id, const ::google::protobuf::MessageLite *msg, bool size_ready);
+        bool sendData(const void *data, size_t size);
 
+    public:
         ServerFunctionBase *findFunction(color_ostream &out, const std::string &plugin, const std::string &name);
     };
 
     class ServerMain {
-        static std::mutex access_;
-        static bool blocked_;
         friend struct BlockGuard;
 
+    protected:
+        static std::shared_mutex access_;
+        static bool blocked_;
+
     public:
 
         static std::future<bool> listen(int port);
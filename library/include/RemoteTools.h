@@ -139,6 +139,9 @@ namespace DFHack
         CoreService();
         ~CoreService();
 
+        // True while the client holds the core through CoreSuspend.
+        bool isSuspended() const { return suspend_depth > 0; }
+
         command_result BindMethod(color_ostream &stream,
                                   const dfproto::CoreBindRequest *in,
                                   dfproto::CoreBindReply *out);
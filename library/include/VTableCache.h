@@ -0,0 +1,95 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <cstddef>
+
+namespace DFHack
+{
+    /**
+     * Lock-free, read-optimized table from vtable pointers to identities.
+     *
+     * Entries are only added by a single writer at a time (callers serialize
+     * insert() and invalidate() themselves) and never move, so readers can
+     * probe the table without locking. The value is published before the
+     * key, so a reader that sees a matching key also sees its identity.
+     * Invalidated entries are kept as stale markers and miss on lookup.
+     */
+    template<typename T>
+    class VTableCache
+    {
+    public:
+        static const size_t SIZE = 8192; // power of two, several times the number of DF classes
+        static const size_t MAX_PROBES = 16;
+
+        VTableCache() {}
+        VTableCache(const VTableCache &) = delete;
+        VTableCache &operator=(const VTableCache &) = delete;
+
+        /// Returns true on a hit; *out may legitimately be NULL for vtables
+        /// that were inserted as unknown.
+        bool find(void *vtable, T **out) const {
+            size_t idx = hash(vtable);
+            for (size_t i = 0; i < MAX_PROBES; i++, idx = (idx + 1) & (SIZE - 1)) {
+                void *key = slots[idx].vtable.load(std::memory_order_acquire);
+                if (!key)
+                    return false;
+                if (key == vtable) {
+                    T *id = slots[idx].identity.load(std::memory_order_acquire);
+                    if (id == stale())
+                        return false;
+                    *out = id;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Adds or replaces the entry. If the probe window is full, lookups
+        /// for this vtable keep missing.
+        void insert(void *vtable, T *id) {
+            size_t idx = hash(vtable);
+            for (size_t i = 0; i < MAX_PROBES; i++, idx = (idx + 1) & (SIZE - 1)) {
+                void *key = slots[idx].vtable.load(std::memory_order_relaxed);
+                if (key == vtable) {
+                    slots[idx].identity.store(id, std::memory_order_release);
+                    return;
+                }
+                if (!key) {
+                    slots[idx].identity.store(id, std::memory_order_release);
+                    slots[idx].vtable.store(vtable, std::memory_order_release);
+                    return;
+                }
+            }
+        }
+
+        void invalidate(void *vtable) {
+            size_t idx = hash(vtable);
+            for (size_t i = 0; i < MAX_PROBES; i++, idx = (idx + 1) & (SIZE - 1)) {
+                void *key = slots[idx].vtable.load(std::memory_order_relaxed);
+                if (!key)
+                    return;
+                if (key == vtable) {
+                    slots[idx].identity.store(stale(), std::memory_order_release);
+                    return;
+                }
+            }
+        }
+
+        static size_t hash(void *vtable) {
+            uint64_t v = uint64_t(uintptr_t(vtable)) >> 3;
+            return size_t((v * 0x9E3779B97F4A7C15ULL) >> 40) & (SIZE - 1);
+        }
+
+    private:
+        struct Slot {
+            std::atomic<void*> vtable{nullptr};
+            std::atomic<T*> identity{nullptr};
+        };
+        Slot slots[SIZE];
+
+        static T *stale() {
+            static char marker;
+            return reinterpret_cast<T*>(&marker);
+        }
+    };
+}
@@ -26,6 +26,8 @@ distribution.
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "Export.h"
 
@@ -39,6 +41,10 @@ namespace DFHack
             VersionInfoFactory();
             ~VersionInfoFactory();
             bool loadFile( std::string path_to_xml);
+            // Like loadFile, but reads the symbol tables for the current OS
+            // from a binary cache when it is newer than the xml file, and
+            // rewrites the cache after parsing the xml otherwise.
+            bool loadFileCached(std::string path_to_xml, std::string path_to_cache);
             bool isInErrorState() const {return error;};
             std::shared_ptr<const VersionInfo> getVersionInfoByMD5(std::string md5string) const;
             std::shared_ptr<const VersionInfo> getVersionInfoByPETimestamp(uintptr_t timestamp) const;
@@ -46,8 +52,12 @@ namespace DFHack
             // trash existing list
             void clear();
         private:
+            struct SymbolTable;
             std::vector<std::shared_ptr<const VersionInfo>> versions;
-            void ParseVersion (TiXmlElement* version, VersionInfo* mem);
+            void ParseVersion (TiXmlElement* version, SymbolTable &table);
+            void addVersions(const std::vector<SymbolTable> &tables);
+            bool readCache(const std::string &path, const std::string &stamp, std::vector<SymbolTable> &tables);
+            void writeCache(const std::string &path, const std::string &stamp, const std::vector<SymbolTable> &tables);
             bool error;
     };
 }
@@ -123,6 +123,12 @@ DFHACK_EXPORT std::string getName(df::building* building);
  */
 DFHACK_EXPORT df::building *findAtTile(df::coord pos);
 
+/**
+ * Find all buildings occupying tiles inside the cuboid, each reported once.
+ * Does not work on civzones.
+ */
+DFHACK_EXPORT bool findInBox(std::vector<df::building*> *pvec, const cuboid &box);
+
 /**
  * Find civzones located at the specified tile.
  */
@@ -123,6 +123,19 @@ namespace DFHack {
         DFHACK_EXPORT int32_t registerTick(EventHandler handler, int32_t when, bool absolute=false);
         DFHACK_EXPORT void unregister(EventType::EventType e, EventHandler handler);
         DFHACK_EXPORT void unregisterAll(Plugin* plugin);
+
+        // INVENTORY_CHANGE checks only every n-th unit each time it runs,
+        // rotating through the units so all are checked over n runs.
+        DFHACK_EXPORT void setInventoryShards(size_t shards);
+        DFHACK_EXPORT size_t getInventoryShards();
+
+        // limits how much time event managers may spend per frame. managers
+        // that are due but do not fit in the budget are deferred to later
+        // frames, but never by more than max_delay_ticks past when they were
+        // due. a budget of 0 (the default) disables the limit.
+        DFHACK_EXPORT void setFrameBudget(uint32_t budget_ms, int32_t max_delay_ticks = 10);
+        DFHACK_EXPORT uint32_t getFrameBudget();
+        DFHACK_EXPORT int32_t getMaxDelayTicks();
         void manageEvents(color_ostream& out);
         void onStateChange(color_ostream& out, state_change_event event);
     }
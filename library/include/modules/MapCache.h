@@ -24,6 +24,7 @@ distribution.
 
 #pragma once
 
+#include "BlockStore.h"
 #include "TileTypes.h"
 
 #include "modules/Maps.h"
@@ -243,6 +244,7 @@ public:
     {
         if(!valid) return false;
         dirty_temperatures = true;
+        markDirty();
         index_tile(temp1,p) = temp;
         return true;
     }
@@ -255,6 +257,7 @@ public:
     {
         if(!valid) return false;
         dirty_temperatures = true;
+        markDirty();
         index_tile(temp2,p) = temp;
         return true;
     }
@@ -276,6 +279,7 @@ public:
     {
         if(!valid) return false;
         dirty_occupancies = true;
+        markDirty();
         index_tile(occupancy,p) = des;
         return true;
     }
@@ -328,7 +332,10 @@ private:
 
     void init();
 
+    void markDirty();
+
     bool valid:1;
+    bool queued_write:1;
     bool dirty_designations:1;
     bool dirty_tiles:1;
     bool dirty_veins:1;
@@ -583,12 +590,9 @@ class DFHACK_EXPORT MapCache
 
     void trash()
     {
-        std::map<DFCoord, Block *>::iterator p;
-        for(p = blocks.begin(); p != blocks.end(); p++)
-        {
-            delete p->second;
-        }
         blocks.clear();
+        dirty_blocks.clear();
+        designated_count = 0;
     }
 
     uint32_t maxBlockX() { return x_bmax; }
@@ -617,6 +621,10 @@ private:
     uint32_t z_max;
     std::vector<BiomeInfo> biomes;
     std::map<df::coord2d, df::world_region_details*> region_details;
-    std::map<DFCoord, Block *> blocks;
+    BlockStore<Block> blocks;
+    // blocks modified since the last WriteAll, in modification order
+    std::vector<Block *> dirty_blocks;
+    // number of tiles with new designations in dirty_blocks
+    size_t designated_count;
 };
 }
@@ -333,6 +333,23 @@ extern DFHACK_EXPORT df::map_block *ensureTileBlock (int32_t x, int32_t y, int32
 
 extern DFHACK_EXPORT df::map_block_column *getBlockColumn(int32_t blockx, int32_t blocky);
 
+/// Number of threads parallelForBlock() fans work out to, including the caller.
+extern DFHACK_EXPORT size_t getParallelWorkerCount();
+
+/**
+ * Calls fn(block, intersection, worker) for every allocated map block in the
+ * tile cuboid, spread across getParallelWorkerCount() threads. Calls with the
+ * same worker index never run concurrently, so fn can accumulate into
+ * per-worker results (and use a per-worker MapExtras::MapCache) without
+ * locking; merge them after this returns. Blocks are not visited in any
+ * particular order.
+ *
+ * The core must be suspended for the whole call and fn must only read game
+ * data. The first exception thrown by fn is rethrown once all threads finish.
+ */
+extern DFHACK_EXPORT void parallelForBlock(const cuboid &box,
+    std::function<void(df::map_block *, const cuboid &, size_t)> fn);
+
 inline df::map_block *getBlock (df::coord pos) { return getBlock(pos.x, pos.y, pos.z); }
 inline df::map_block *getTileBlock (df::coord pos) { return getTileBlock(pos.x, pos.y, pos.z); }
 inline df::map_block *ensureTileBlock (df::coord pos) { return ensureTileBlock(pos.x, pos.y, pos.z); }
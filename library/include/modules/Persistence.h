@@ -33,6 +33,7 @@ distribution.
 #include "Error.h"
 #include "Export.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -61,31 +62,37 @@ namespace DFHack
         int entity_id() const;
         const std::string &key() const;
 
-        // these throw if used when isValid() returns false
+        // these throw if used when isValid() returns false. The non-const
+        // versions (and pdata()) mark the store as changed on every call, so
+        // use the const versions or get_int/get_str below for reading.
         std::string &val();
         const std::string &val() const;
         int &ival(int i);
         int ival(int i) const;
 
+        // Makes the next save write out the store this item belongs to. Only
+        // needed after writing through a reference kept from an earlier call.
+        void markDirty();
+
         // safer, non-throwing accessors with convenience bool functions
         int get_int(int i) const {
             if (!isValid())
                 return -1;
             return ival(i);
         }
-        bool get_bool(int i) {
+        bool get_bool(int i) const {
             return get_int(i) == 1;
         }
         void set_int(int i, int value) {
-            if (isValid())
+            if (isValid() && get_int(i) != value)
                 ival(i) = value;
         }
         void set_bool(int i, bool value) {
             set_int(i, value ? 1 : 0);
         }
-        const std::string & get_str();
+        const std::string & get_str() const;
         void set_str(const std::string & value) {
-            if (isValid())
+            if (isValid() && get_str() != value)
                 val() = value;
         }
 
@@ -188,6 +195,8 @@ namespace DFHack
             static void clear(color_ostream& out);
             static void save(color_ostream& out);
             static void load(color_ostream& out);
+            // waits for files queued by save() to be written
+            static void flush();
             friend class ::DFHack::Core;
         };
 
@@ -213,5 +222,13 @@ namespace DFHack
         // Fills the vector with references to each persistent item with a key that is
         // equal to the given key.
         DFHACK_EXPORT void getAllByKey(std::vector<PersistentDataItem> &vec, int entity_id, const std::string &key);
+        // Calls fn with each persistent item with a key that is equal to the given key,
+        // without copying the items. fn must not add or delete items.
+        DFHACK_EXPORT void forEachByKey(int entity_id, const std::string &key,
+                                        const std::function<void(const PersistentDataItem &)> &fn);
+        // Calls fn with each persistent item with a key that is greater than or equal to
+        // "min" and less than "max", without copying the items. fn must not add or delete items.
+        DFHACK_EXPORT void forEachByKeyRange(int entity_id, const std::string &min, const std::string &max,
+                                             const std::function<void(const PersistentDataItem &)> &fn);
     }
 }
@@ -3,11 +3,17 @@
 local _ENV = mkmodule('helpdb')
 
 local argparse = require('argparse')
+local json = require('json')
 
 -- paths
 local RENDERED_PATH = 'hack/docs/docs/tools/'
 local TAG_DEFINITIONS = 'hack/docs/docs/Tags.txt'
 
+-- parsed help text from rendered docs and scripts is saved here so it does not
+-- have to be parsed again in later sessions. set to false to disable.
+cache_path = 'hack/helpdb-cache.json'
+local CACHE_VERSION = 1
+
 -- used when reading help text embedded in script sources
 local SCRIPT_DOC_BEGIN = '[====['
 local SCRIPT_DOC_END = ']====]'
@@ -35,6 +41,7 @@ local BUILTINS = {
     clear='cls',
     cls=true,
     ['devel/dump-rpc']=true,
+    ['devel/profile']=true,
     die=true,
     dir='ls',
     disable=true,
@@ -88,6 +95,16 @@ local entrydb = {}
 -- will have an empty list.
 local tag_index = {}
 
+-- rendered help file path -> mtime, filled in as files are checked during a
+-- scan so each file is only stat'ed once per refresh
+local rendered_mtimes = {}
+
+-- whether any help text was (re)parsed during the current scan
+local textdb_changed = false
+
+-- sorted result of get_commands(), cleared on refresh
+local command_list = nil
+
 ---------------------------------------------------------------------------
 -- data ingestion
 ---------------------------------------------------------------------------
@@ -96,8 +113,18 @@ local function get_rendered_path(entry_name)
     return RENDERED_PATH .. entry_name .. '.txt'
 end
 
+local function get_rendered_mtime(entry_name)
+    local path = get_rendered_path(entry_name)
+    local mtime = rendered_mtimes[path]
+    if not mtime then
+        mtime = dfhack.filesystem.mtime(path)
+        rendered_mtimes[path] = mtime
+    end
+    return mtime
+end
+
 local function has_rendered_help(entry_name)
-    return dfhack.filesystem.mtime(get_rendered_path(entry_name)) ~= -1
+    return get_rendered_mtime(entry_name) ~= -1
 end
 
 local DEFAULT_HELP_TEMPLATE = [[
@@ -211,12 +238,13 @@ end
 -- create db entry based on parsing sphinx-rendered help text
 local function make_rendered_entry(old_entry, entry_name, kwargs)
     local source_path = get_rendered_path(entry_name)
-    local source_timestamp = dfhack.filesystem.mtime(source_path)
+    local source_timestamp = get_rendered_mtime(entry_name)
     if old_entry and old_entry.help_source == HELP_SOURCES.RENDERED and
             old_entry.source_timestamp >= source_timestamp then
         -- we already have the latest info
         return old_entry
     end
+    textdb_changed = true
     kwargs.source_path, kwargs.source_timestamp = source_path, source_timestamp
     local entry = make_default_entry(entry_name, HELP_SOURCES.RENDERED, kwargs)
     local ok, lines = pcall(io.lines, source_path)
@@ -230,7 +258,7 @@ end
 -- create db entry based on the help text in the plugin source (used by
 -- out-of-tree plugins)
 local function make_plugin_entry(old_entry, entry_name, kwargs)
-    if old_entry and old_entry.source == HELP_SOURCES.PLUGIN then
+    if old_entry and old_entry.help_source == HELP_SOURCES.PLUGIN then
         -- we can't tell when a plugin is reloaded, so we can either choose to
         -- always refresh or never refresh. let's go with never for now for
         -- performance.
@@ -249,12 +277,13 @@ end
 local function make_script_entry(old_entry, entry_name, kwargs)
     local source_path = kwargs.source_path
     local source_timestamp = dfhack.filesystem.mtime(source_path)
-    if old_entry and old_entry.source == HELP_SOURCES.SCRIPT and
+    if old_entry and old_entry.help_source == HELP_SOURCES.SCRIPT and
             old_entry.source_path == source_path and
             old_entry.source_timestamp >= source_timestamp then
         -- we already have the latest info
         return old_entry
     end
+    textdb_changed = true
     kwargs.source_timestamp, kwargs.entry_type = source_timestamp
     local entry = make_default_entry(entry_name, HELP_SOURCES.SCRIPT, kwargs)
     local ok, lines = pcall(io.lines, source_path)
@@ -404,6 +433,64 @@ local function index_tags()
     end
 end
 
+---------------------------------------------------------------------------
+-- persistent cache
+---------------------------------------------------------------------------
+
+-- only text parsed from files is cached; the source timestamps tell us when
+-- it is out of date. plugin help can change without any file changing, so it
+-- is always read fresh from the loaded plugins.
+local CACHED_SOURCES = {
+    [HELP_SOURCES.RENDERED]=true,
+    [HELP_SOURCES.SCRIPT]=true,
+}
+
+-- help text is stored in the db in the DF encoding, but json wants utf-8
+local function load_cache()
+    if not cache_path then return {} end
+    local ok, data = pcall(json.decode_file, cache_path)
+    if not ok or type(data) ~= 'table' or data.version ~= CACHE_VERSION or
+            data.dfhack ~= dfhack.getGitDescription() or
+            type(data.entries) ~= 'table' then
+        return {}
+    end
+    local db = {}
+    for entry_name,entry in pairs(data.entries) do
+        if CACHED_SOURCES[entry.help_source] then
+            entry.short_help = dfhack.utf2df(entry.short_help or '')
+            entry.long_help = dfhack.utf2df(entry.long_help or '')
+            entry.tags = entry.tags or {}
+            entry.source_timestamp = entry.source_timestamp or 0
+            db[entry_name] = entry
+        end
+    end
+    return db
+end
+
+local function save_cache()
+    if not cache_path then return end
+    local entries = {}
+    for entry_name,entry in pairs(textdb) do
+        if CACHED_SOURCES[entry.help_source] then
+            entries[entry_name] = {
+                help_source=entry.help_source,
+                short_help=dfhack.df2utf(entry.short_help),
+                long_help=dfhack.df2utf(entry.long_help),
+                tags=entry.tags,
+                source_timestamp=entry.source_timestamp,
+                source_path=entry.source_path,
+            }
+        end
+    end
+    local ok, err = pcall(json.encode_file,
+            {version=CACHE_VERSION, dfhack=dfhack.getGitDescription(),
+             entries=entries},
+            cache_path, {pretty=false})
+    if not ok then
+        dfhack.printerr(('failed to write help cache: %s'):format(err))
+    end
+end
+
 local needs_refresh = true
 
 -- ensures the db is loaded
@@ -412,13 +499,20 @@ local function ensure_db()
     needs_refresh = false
 
     local old_db = textdb
+    if not next(old_db) then
+        old_db = load_cache()
+    end
     textdb, entrydb, tag_index = {}, {}, {}
+    rendered_mtimes, textdb_changed, command_list = {}, false, nil
 
     initialize_tags()
     scan_builtins(old_db)
     scan_plugins(old_db)
     scan_scripts(old_db)
     index_tags()
+    if textdb_changed then
+        save_cache()
+    end
     if is_tag('armok') then
         dfhack.internal.setArmokTools(get_tag_data('armok'))
     end
@@ -708,8 +802,15 @@ end
 
 -- returns a list of all commands. used by Core's autocomplete functionality.
 function get_commands()
-    local include = {entry_type=ENTRY_TYPES.COMMAND}
-    return search_entries(include)
+    ensure_db()
+    if not command_list then
+        command_list = search_entries({entry_type=ENTRY_TYPES.COMMAND})
+    end
+    local commands = {}
+    for i,command in ipairs(command_list) do
+        commands[i] = command
+    end
+    return commands
 end
 
 function is_builtin(command)
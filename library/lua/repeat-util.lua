@@ -27,16 +27,16 @@ end
 function scheduleEvery(name, time, timeUnits, func)
     cancel(name)
     local function helper()
-        local now_ms = dfhack.getTickCount()
         func()
-        dfhack.internal.recordRepeatRuntime(name, now_ms)
-
         if repeating[name] then
-            repeating[name] = dfhack.timeout(time, timeUnits, helper)
+            -- runtime of timed calls is recorded under the name by the core
+            repeating[name] = dfhack.timeout(time, timeUnits, helper, name)
         end
     end
     repeating[name] = -1
+    local now_ms = dfhack.getTickCount()
     helper()
+    dfhack.internal.recordRepeatRuntime(name, now_ms)
 end
 
 function scheduleUnlessAlreadyScheduled(name, time, timeUnits, func)
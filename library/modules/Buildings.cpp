@@ -85,8 +85,10 @@ distribution.
 #include <cstdlib>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace DFHack;
@@ -104,13 +106,64 @@ using std::string;
 using std::unordered_map;
 using std::vector;
 
-struct CoordHash {
-    size_t operator()(const df::coord pos) const {
-        return pos.x*65537 + pos.y*17 + pos.z;
-    }
+/*
+ * Building occupancy index: one lazily allocated 16x16 array of building ids
+ * per map block, addressed densely by block coordinates. Updated whenever
+ * buildings are linked, destroyed or reported by the BUILDING event.
+ */
+struct BlockBuildingIndex {
+    int32_t tiles[16][16];
+    BlockBuildingIndex() { std::fill(&tiles[0][0], &tiles[0][0] + 16*16, -1); }
 };
 
-static unordered_map<df::coord, int32_t, CoordHash> locationToBuilding;
+static vector<std::unique_ptr<BlockBuildingIndex>> buildingIndex;
+static int32_t buildingIndexX = 0, buildingIndexY = 0, buildingIndexZ = 0;
+
+// bounding boxes of the buildings in the index, by id
+static unordered_map<int32_t, df::coord> corner1;
+static unordered_map<int32_t, df::coord> corner2;
+
+static void cacheBuilding(df::building *building);
+
+// Empties the index for a map of the given size in blocks. The bounding boxes
+// go with it, since they are what tells updateBuildings that a building is
+// already indexed.
+static void resetBuildingIndex(int32_t x, int32_t y, int32_t z) {
+    corner1.clear();
+    corner2.clear();
+    buildingIndex.clear();
+    buildingIndex.resize(size_t(std::max(x, 0)) * std::max(y, 0) * std::max(z, 0));
+    buildingIndexX = x;
+    buildingIndexY = y;
+    buildingIndexZ = z;
+}
+
+static BlockBuildingIndex *getIndexBlock(df::coord pos, bool create) {
+    int32_t x, y, z;
+    Maps::getSize(x, y, z);
+    if (x != buildingIndexX || y != buildingIndexY || z != buildingIndexZ) {
+        if (!create)
+            return NULL;
+        resetBuildingIndex(x, y, z);
+        for (auto bld : df::building::get_vector())
+            if (bld->isSettingOccupancy())
+                cacheBuilding(bld);
+    }
+
+    int32_t bx = pos.x >> 4, by = pos.y >> 4;
+    if (pos.x < 0 || pos.y < 0 || pos.z < 0 || bx >= x || by >= y || pos.z >= z)
+        return NULL;
+
+    auto &block = buildingIndex[(size_t(pos.z) * y + by) * x + bx];
+    if (!block && create)
+        block.reset(new BlockBuildingIndex());
+    return block.get();
+}
+
+static int32_t *getIndexedTile(df::coord pos, bool create) {
+    auto block = getIndexBlock(pos, create);
+    return block ? &block->tiles[pos.x & 15][pos.y & 15] : NULL;
+}
 
 static df::building_extents_type *getExtentTile(df::building_extents &extent, df::coord2d tile)
 {
@@ -379,10 +432,10 @@ df::building *Buildings::findAtTile(df::coord pos)
         return NULL;
 
     // Try cache lookup in case it works:
-    auto cached = locationToBuilding.find(pos);
-    if (cached != locationToBuilding.end())
+    int32_t *cached = getIndexedTile(pos, false);
+    if (cached && *cached != -1)
     {
-        auto building = df::building::find(cached->second);
+        auto building = df::building::find(*cached);
 
         if (building && building->z == pos.z &&
             building->isSettingOccupancy() &&
@@ -419,8 +472,6 @@ df::building *Buildings::findAtTile(df::coord pos)
     return NULL;
 }
 
-static unordered_map<int32_t, df::coord> corner1;
-static unordered_map<int32_t, df::coord> corner2;
 static void cacheBuilding(df::building *building) {
     int32_t id = building->id;
     df::coord p1(std::min(building->x1, building->x2), std::min(building->y1,building->y2), building->z);
@@ -433,12 +484,63 @@ static void cacheBuilding(df::building *building) {
         for (int32_t y = p1.y; y <= p2.y; y++) {
             df::coord pt(x, y, building->z);
             if (Buildings::containsTile(building, pt)) {
-                locationToBuilding[pt] = id;
+                if (int32_t *tile = getIndexedTile(pt, true))
+                    *tile = id;
             }
         }
     }
 }
 
+static void uncacheBuilding(int32_t id) {
+    auto it = corner1.find(id);
+    if (it == corner1.end())
+        return;
+
+    df::coord p1 = it->second;
+    df::coord p2 = corner2[id];
+
+    for (int32_t x = p1.x; x <= p2.x; x++) {
+        for (int32_t y = p1.y; y <= p2.y; y++) {
+            int32_t *tile = getIndexedTile(df::coord(x, y, p1.z), false);
+            if (tile && *tile == id)
+                *tile = -1;
+        }
+    }
+
+    corner1.erase(it);
+    corner2.erase(id);
+}
+
+bool Buildings::findInBox(std::vector<df::building*> *pvec, const cuboid &box)
+{
+    pvec->clear();
+    if (!box.isValid())
+        return false;
+
+    std::unordered_set<df::building*> seen;
+    box.forBlock([&](df::map_block *block, cuboid part) {
+        auto index = getIndexBlock(block->map_pos, false);
+        for (int16_t x = part.x_min; x <= part.x_max; x++) {
+            for (int16_t y = part.y_min; y <= part.y_max; y++) {
+                if (!block->occupancy[x & 15][y & 15].bits.building)
+                    continue;
+                df::coord pos(x, y, part.z_min);
+                df::building *bld = NULL;
+                int32_t id = index ? index->tiles[x & 15][y & 15] : -1;
+                if (id != -1)
+                    bld = df::building::find(id);
+                if (!bld || bld->z != pos.z || !bld->isSettingOccupancy() || !containsTile(bld, pos))
+                    bld = findAtTile(pos);
+                if (bld && seen.insert(bld).second)
+                    pvec->push_back(bld);
+            }
+        }
+        return true;
+    });
+
+    return !pvec->empty();
+}
+
 bool Buildings::findCivzonesAt(std::vector<df::building_civzonest*> *pvec,
                                df::coord pos) {
     pvec->clear();
@@ -1031,7 +1133,10 @@ static void linkBuilding(df::building *bld)
     bld->categorize(true);
 
     if (bld->isSettingOccupancy())
+    {
         markBuildingTiles(bld, false);
+        cacheBuilding(bld);
+    }
 
     Job::checkBuildingsNow();
 }
@@ -1319,6 +1424,8 @@ bool Buildings::deconstruct(df::building *bld)
         return true;
     bld->flags.bits.almost_deleted = true;
 
+    uncacheBuilding(bld->id);
+
     if (bld->isSettingOccupancy()) {
         markBuildingTiles(bld, true);
         bld->cleanupMap();
@@ -1463,9 +1570,7 @@ void Buildings::notifyCivzoneModified(df::building* bld)
 }
 
 void Buildings::clearBuildings(color_ostream& out) {
-    corner1.clear();
-    corner2.clear();
-    locationToBuilding.clear();
+    resetBuildingIndex(0, 0, 0);
 }
 
 void Buildings::updateBuildings(color_ostream&, void* ptr)
@@ -1479,26 +1584,12 @@ void Buildings::updateBuildings(color_ostream&, void* ptr)
         if (!corner1.count(id) && !is_civzone)
             cacheBuilding(building);
     }
-    else if (corner1.count(id))
+    else
     {
         // existing building: destroy it
         // note that civzones are lazy-destroyed in findCivzonesAt() and are
         // not handled here
-        df::coord p1 = corner1[id];
-        df::coord p2 = corner2[id];
-
-        for ( int32_t x = p1.x; x <= p2.x; x++ ) {
-            for ( int32_t y = p1.y; y <= p2.y; y++ ) {
-                df::coord pt(x,y,p1.z);
-
-                auto cur = locationToBuilding.find(pt);
-                if (cur != locationToBuilding.end() && cur->second == id)
-                    locationToBuilding.erase(cur);
-            }
-        }
-
-        corner1.erase(id);
-        corner2.erase(id);
+        uncacheBuilding(id);
     }
 }
 
@@ -38,6 +38,7 @@
 #include "df/world.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <map>
 #include <string>
@@ -69,6 +70,12 @@ static int32_t eventLastTick[EventType::EVENT_MAX];
 
 static const int32_t ticksPerYear = 403200;
 
+//scheduling
+static uint32_t frameBudgetMs = 0;
+static int32_t maxDelayTicks = 10;
+// exponentially weighted moving average of the cost of each manager, in microseconds
+static uint32_t managerCostUs[EventType::EVENT_MAX];
+
 void DFHack::EventManager::registerListener(EventType::EventType e, EventHandler handler) {
     DEBUG(log).print("registering handler %p from plugin %s for event %d\n", handler.eventHandler, !handler.plugin ? "<null>" : handler.plugin->getName().c_str(), e);
     handlers[e].insert(pair<Plugin*, EventHandler>(handler.plugin, handler));
@@ -132,6 +139,20 @@ void DFHack::EventManager::unregisterAll(Plugin* plugin) {
     }
 }
 
+void DFHack::EventManager::setFrameBudget(uint32_t budget_ms, int32_t max_delay_ticks) {
+    DEBUG(log).print("setting frame budget to %u ms, max delay %d ticks\n", budget_ms, max_delay_ticks);
+    frameBudgetMs = budget_ms;
+    maxDelayTicks = std::max(0, max_delay_ticks);
+}
+
+uint32_t DFHack::EventManager::getFrameBudget() {
+    return frameBudgetMs;
+}
+
+int32_t DFHack::EventManager::getMaxDelayTicks() {
+    return maxDelayTicks;
+}
+
 static void manageTickEvent(color_ostream& out);
 static void manageJobInitiatedEvent(color_ostream& out);
 static void manageJobStartedEvent(color_ostream& out);
@@ -227,6 +248,21 @@ static unordered_set<int32_t> activeUnits;
 //unit death
 static unordered_set<int32_t> livingUnits;
 
+//unit change journal
+/*
+ * UNIT_NEW_ACTIVE and UNIT_DEATH are both derived from the same unit lists.
+ * Instead of each manager rescanning them, the journal walks world->units.active
+ * at most once per tick and queues the deltas for each consumer, so managers
+ * that fire at different frequencies still see every change. Deaths are found
+ * by looking up only the tracked living units that are not in the active list,
+ * instead of scanning units.all. Each update is still linear in the number of
+ * active and tracked living units; DF has no hook for units being added to or
+ * removed from its lists that the journal could be driven from instead.
+ */
+static int32_t unitJournalTick = -1;
+static vector<int32_t> pendingNewActiveUnits;
+static vector<int32_t> pendingDeadUnits;
+
 //item creation
 static int32_t nextItem;
 
@@ -257,6 +293,36 @@ static int32_t nextInvasion;
 //static unordered_map<int32_t, vector<df::unit_inventory_item> > equipmentLog;
 static unordered_map<int32_t, vector<InventoryItem>> equipmentLog;
 
+/*
+ * Compact per-unit summary of the fields that the inventory diff looks at.
+ * Units whose current inventory still matches their fingerprint are skipped
+ * without building the full id -> item diff.
+ */
+struct InventoryFingerprint {
+    int32_t item_id;
+    int32_t wound_id;
+    int16_t body_part_id;
+    int16_t mode;
+
+    bool operator==(const df::unit_inventory_item &inv) const {
+        return item_id == inv.item->id && wound_id == inv.wound_id
+            && body_part_id == inv.body_part_id && mode == inv.mode;
+    }
+};
+static unordered_map<int32_t, vector<InventoryFingerprint>> inventoryFingerprints;
+static size_t inventoryShardCount = 1;
+static size_t inventoryShard = 0;
+
+void DFHack::EventManager::setInventoryShards(size_t shards) {
+    DEBUG(log).print("setting inventory shards to %zu\n", shards);
+    inventoryShardCount = std::max<size_t>(1, shards);
+    inventoryShard = 0;
+}
+
+size_t DFHack::EventManager::getInventoryShards() {
+    return inventoryShardCount;
+}
+
 //report
 static int32_t lastReport;
 
@@ -282,7 +348,13 @@ static void run_handler(color_ostream& out, EventType::EventType eventType, cons
     auto &counters = core.perf_counters;
     uint32_t start_ms = core.p->getTickCount();
     const char * plugin_name = !handle.plugin ? "<null>" : handle.plugin->getName().c_str();
-    handle.eventHandler(out, arg);
+    if (handle.plugin) {
+        FrameProfiler::Scope scope(core.frame_profiler, "event handler", handle.plugin);
+        handle.eventHandler(out, arg);
+    } else {
+        FrameProfiler::Scope scope(core.frame_profiler, "event handler", "<null>");
+        handle.eventHandler(out, arg);
+    }
     counters.incCounter(counters.event_manager_event_per_plugin_ms[eventType][plugin_name], start_ms);
 }
 
@@ -307,7 +379,12 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
         buildings.clear();
         constructions.clear();
         equipmentLog.clear();
+        inventoryFingerprints.clear();
+        inventoryShard = 0;
         activeUnits.clear();
+        unitJournalTick = -1;
+        pendingNewActiveUnits.clear();
+        pendingDeadUnits.clear();
 
         Buildings::clearBuildings(out);
         lastReport = -1;
@@ -369,6 +446,7 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
         for (auto unit : df::global::world->units.all) {
             if (Units::isActive(unit)) {
                 activeUnits.emplace(unit->id);
+                livingUnits.emplace(unit->id);
             }
             for (auto syndrome : unit->syndromes.active) {
                 int32_t startTime = syndrome->year*ticksPerYear + syndrome->year_time;
@@ -387,6 +465,9 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
         for (int &last_tick : eventLastTick) {
             last_tick = -1;//-1000000;
         }
+        for (uint32_t &cost : managerCostUs) {
+            cost = 0;
+        }
         for (auto unit : df::global::world->history.figures) {
             if ( unit->id < 0 && unit->name.language < 0 )
                 unit->name.language = 0;
@@ -409,8 +490,12 @@ void DFHack::EventManager::manageEvents(color_ostream& out) {
     int32_t tick = df::global::world->frame_counter;
     TRACE(log,out).print("processing events at tick %d\n", tick);
 
-    auto &core = Core::getInstance();
-    auto &counters = core.perf_counters;
+    struct DueManager {
+        size_t type;
+        int32_t lateness; // ticks past the point where the manager was due
+    };
+    std::vector<DueManager> due;
+
     for ( size_t a = 0; a < EventType::EVENT_MAX; a++ ) {
         if ( handlers[a].empty() )
             continue;
@@ -425,10 +510,40 @@ void DFHack::EventManager::manageEvents(color_ostream& out) {
         if ( tick >= eventLastTick[a] && tick - eventLastTick[a] < eventFrequency )
             continue;
 
+        int32_t lateness = eventLastTick[a] < 0 || tick < eventLastTick[a] ? maxDelayTicks
+            : tick - eventLastTick[a] - std::max(eventFrequency, 1);
+        due.push_back({a, lateness});
+    }
+
+    // when over budget, the managers that have waited the longest go first
+    if (frameBudgetMs)
+        std::stable_sort(due.begin(), due.end(), [](const DueManager &a, const DueManager &b) {
+            return a.lateness > b.lateness;
+        });
+
+    auto &core = Core::getInstance();
+    auto &counters = core.perf_counters;
+    const uint64_t budget_us = uint64_t(frameBudgetMs) * 1000;
+    uint64_t spent_us = 0;
+    for (auto &[a, lateness] : due) {
+        // tick events are scheduled by their handlers and are never deferred
+        if ( budget_us && a != EventType::TICK && lateness < maxDelayTicks
+                && spent_us + managerCostUs[a] > budget_us ) {
+            TRACE(log,out).print("deferring event manager %zu (cost %u us, %d ticks late)\n",
+                    a, managerCostUs[a], lateness);
+            continue;
+        }
+
         uint32_t start_ms = core.p->getTickCount();
+        auto start = std::chrono::steady_clock::now();
         eventManager[a](out);
         eventLastTick[a] = tick;
         counters.incCounter(counters.event_manager_event_total_ms[a], start_ms);
+
+        uint64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        spent_us += elapsed_us;
+        managerCostUs[a] = managerCostUs[a] ? (managerCostUs[a] * 7 + elapsed_us) / 8 : elapsed_us;
     }
 }
 
@@ -719,27 +834,64 @@ static void manageJobCompletedEvent(color_ostream& out) {
     prevJobs = std::move(nowJobs);
 }
 
-static void manageNewUnitActiveEvent(color_ostream& out) {
-    if (!df::global::world)
+static void updateUnitJournal() {
+    int32_t tick = df::global::world->frame_counter;
+    if (tick == unitJournalTick)
         return;
+    unitJournalTick = tick;
+
+    bool want_new_active = !handlers[EventType::UNIT_NEW_ACTIVE].empty();
+    bool want_dead = !handlers[EventType::UNIT_DEATH].empty();
 
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::UNIT_NEW_ACTIVE].begin(), handlers[EventType::UNIT_NEW_ACTIVE].end());
     unordered_set<int32_t> next_activeUnits;
-    vector<int32_t> newly_active_unit_ids;
+    next_activeUnits.reserve(activeUnits.size());
     for (df::unit* unit : df::global::world->units.active) {
         if (!Units::isActive(unit))
             continue;
         next_activeUnits.emplace(unit->id);
-        if (!activeUnits.count(unit->id))
-            newly_active_unit_ids.emplace_back(unit->id);
+        livingUnits.emplace(unit->id);
+        if (want_new_active && !activeUnits.count(unit->id))
+            pendingNewActiveUnits.emplace_back(unit->id);
+    }
+
+    // only units that are no longer active can have died since the last scan
+    for (auto it = livingUnits.begin(); it != livingUnits.end(); ) {
+        int32_t unit_id = *it;
+        if (next_activeUnits.count(unit_id)) {
+            ++it;
+            continue;
+        }
+        df::unit* unit = df::unit::find(unit_id);
+        if (!unit) {
+            it = livingUnits.erase(it);
+            continue;
+        }
+        if (Units::isActive(unit) || !Units::isDead(unit)) {
+            ++it; // for units that have left the map but aren't dead
+            continue;
+        }
+        if (want_dead)
+            pendingDeadUnits.emplace_back(unit_id);
+        it = livingUnits.erase(it);
     }
+
+    activeUnits = std::move(next_activeUnits);
+}
+
+static void manageNewUnitActiveEvent(color_ostream& out) {
+    if (!df::global::world)
+        return;
+
+    multimap<Plugin*,EventHandler> copy(handlers[EventType::UNIT_NEW_ACTIVE].begin(), handlers[EventType::UNIT_NEW_ACTIVE].end());
+    updateUnitJournal();
+    vector<int32_t> newly_active_unit_ids;
+    newly_active_unit_ids.swap(pendingNewActiveUnits);
     for (int32_t unit_id : newly_active_unit_ids) {
         for (auto &[_,handle] : copy) {
             DEBUG(log,out).print("calling handler for new unit event\n");
             run_handler(out, EventType::UNIT_NEW_ACTIVE, handle, (void*) intptr_t(unit_id)); // intptr_t() avoids cast from smaller type warning
         }
     }
-    activeUnits = std::move(next_activeUnits);
 }
 
 
@@ -747,21 +899,9 @@ static void manageUnitDeathEvent(color_ostream& out) {
     if (!df::global::world)
         return;
     multimap<Plugin*,EventHandler> copy(handlers[EventType::UNIT_DEATH].begin(), handlers[EventType::UNIT_DEATH].end());
+    updateUnitJournal();
     vector<int32_t> dead_unit_ids;
-    for (auto unit : df::global::world->units.all) {
-        //if ( unit->counters.death_id == -1 ) {
-        if ( Units::isActive(unit) ) {
-            livingUnits.insert(unit->id);
-            continue;
-        }
-        if (!Units::isDead(unit)) continue; // for units that have left the map but aren't dead
-        //dead: if dead since last check, trigger events
-        if ( livingUnits.find(unit->id) == livingUnits.end() )
-            continue;
-        livingUnits.erase(unit->id);
-        dead_unit_ids.emplace_back(unit->id);
-    }
-
+    dead_unit_ids.swap(pendingDeadUnits);
     for (int32_t unit_id : dead_unit_ids) {
         for (auto &[_,handle] : copy) {
             DEBUG(log,out).print("calling handler for unit death event\n");
@@ -824,6 +964,14 @@ static void manageBuildingEvent(color_ostream& out) {
      * TODO: could be faster
      * consider looking at jobs: building creation / destruction
      **/
+    /*
+     * nothing was created and the number of buildings still matches the ones
+     * we are tracking, so nothing can have been destroyed either
+     */
+    if (nextBuilding == *df::global::building_next_id
+            && buildings.size() == df::global::world->buildings.all.size())
+        return;
+
     multimap<Plugin*,EventHandler> copy(handlers[EventType::BUILDING].begin(), handlers[EventType::BUILDING].end());
     //first alert people about new buildings
     vector<int32_t> new_buildings;
@@ -978,7 +1126,30 @@ static void manageEquipmentEvent(color_ostream& out) {
     // and then once we are done we delete everything.
     vector<InventoryItem*> changed_items;
 
-    for (auto unit : df::global::world->units.all) {
+    auto & units = df::global::world->units.all;
+    size_t shard = inventoryShard;
+    inventoryShard = (inventoryShard + 1) % inventoryShardCount;
+
+    // after a full rotation every unit has an entry, so any extra entries
+    // belong to units that have left units.all
+    if (shard == 0 && (inventoryFingerprints.size() > units.size() || equipmentLog.size() > units.size())) {
+        unordered_set<int32_t> present;
+        present.reserve(units.size());
+        for (auto unit : units)
+            present.insert(unit->id);
+        std::erase_if(inventoryFingerprints, [&](auto &entry) { return !present.count(entry.first); });
+        std::erase_if(equipmentLog, [&](auto &entry) { return !present.count(entry.first); });
+    }
+
+    for (size_t idx = shard; idx < units.size(); idx += inventoryShardCount) {
+        auto unit = units[idx];
+
+        auto & fingerprint = inventoryFingerprints[unit->id];
+        if (fingerprint.size() == unit->inventory.size()
+                && std::equal(fingerprint.begin(), fingerprint.end(), unit->inventory.begin(),
+                    [](const InventoryFingerprint &fp, df::unit_inventory_item *inv) { return fp == *inv; }))
+            continue;
+
         itemIdToInventoryItem.clear();
         currentlyEquipped.clear();
         /*if ( unit->flags1.bits.inactive )
@@ -1036,9 +1207,11 @@ static void manageEquipmentEvent(color_ostream& out) {
         //update equipment
         vector<InventoryItem>& equipment = equipmentLog[unit->id];
         equipment.clear();
+        fingerprint.clear();
         for (auto dfitem : unit->inventory) {
             InventoryItem item(dfitem->item->id, *dfitem);
             equipment.push_back(item);
+            fingerprint.push_back({dfitem->item->id, dfitem->wound_id, dfitem->body_part_id, int16_t(dfitem->mode)});
         }
     }
 
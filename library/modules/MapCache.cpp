@@ -71,6 +71,7 @@ distribution.
 #include "df/world_underground_region.h"
 #include "df/z_level_flags.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <map>
@@ -108,6 +109,7 @@ MapExtras::Block::Block(MapCache *parent, DFCoord _bcoord) :
     dirty_veins = false;
     dirty_temperatures = false;
     dirty_occupancies = false;
+    queued_write = false;
     valid = false;
     bcoord = _bcoord;
     block = Maps::getBlock(bcoord);
@@ -247,6 +249,7 @@ bool MapExtras::Block::setFlagAt(df::coord2d p, df::tile_designation::Mask mask,
     if (cur != set)
     {
         dirty_designations = true;
+        markDirty();
         val.whole = (set ? val.whole | mask : val.whole & ~mask);
     }
     return true;
@@ -260,6 +263,7 @@ bool MapExtras::Block::setFlagAt(df::coord2d p, df::tile_occupancy::Mask mask, b
     if (cur != set)
     {
         dirty_occupancies = true;
+        markDirty();
         val.whole = (set ? val.whole | mask : val.whole & ~mask);
     }
     return true;
@@ -276,6 +280,8 @@ bool MapExtras::Block::setTiletypeAt(df::coord2d pos, df::tiletype tt, bool forc
     pos = pos & 15;
 
     dirty_tiles = true;
+
+    markDirty();
     tiles->raw_tiles[pos.x][pos.y] = tt;
     tiles->dirty_raw.setassignment(pos, true);
 
@@ -302,7 +308,13 @@ bool MapExtras::Block::setDesignationAt(df::coord2d p, df::tile_designation des,
 {
     if(!valid) return false;
     dirty_designations = true;
-    designated_tiles[(p.x&15) + (p.y&15)*16] = true;
+    markDirty();
+    size_t tile_idx = (p.x&15) + (p.y&15)*16;
+    if (!designated_tiles.test(tile_idx))
+    {
+        designated_tiles.set(tile_idx);
+        parent->designated_count++;
+    }
     //printf("setting block %d/%d/%d , %d %d\n",x,y,z, p.x, p.y);
     index_tile(designation,p) = des;
     if((des.bits.dig || des.bits.smooth) && block) {
@@ -369,6 +381,8 @@ bool MapExtras::Block::setVeinMaterialAt(df::coord2d pos, int16_t mat, df::inclu
     }
 
     dirty_veins = true;
+
+    markDirty();
     cur_mat = mat;
     cur_type = (uint8_t)type;
     basemats->vein_dirty.setassignment(pos, true);
@@ -423,6 +437,7 @@ bool MapExtras::Block::setStoneAt(df::coord2d pos, df::tiletype tile, int16_t ma
     if (cur_tile != tile)
     {
         dirty_tiles = true;
+        markDirty();
         tiles->set_base_tile(pos, tile);
     }
 
@@ -457,6 +472,7 @@ bool MapExtras::Block::setSoilAt(df::coord2d pos, df::tiletype tile, bool kill_v
     if (cur_tile != tile)
     {
         dirty_tiles = true;
+        markDirty();
         tiles->set_base_tile(pos, tile);
     }
 
@@ -763,6 +779,14 @@ t_blockflags MapExtras::Block::BlockFlags()
     return block ? block->flags : t_blockflags();
 }
 
+void MapExtras::Block::markDirty()
+{
+    if (queued_write)
+        return;
+    queued_write = true;
+    parent->dirty_blocks.push_back(this);
+}
+
 bool MapExtras::Block::isDirty()
 {
     return valid && (
@@ -1237,8 +1261,10 @@ bool MapExtras::Block::removeItemOnGround(df::item *item)
 MapExtras::MapCache::MapCache()
 {
     valid = 0;
+    designated_count = 0;
     Maps::getSize(x_bmax, y_bmax, z_max);
     x_tmax = x_bmax*16; y_tmax = y_bmax*16;
+    blocks.resize(x_bmax, y_bmax, z_max);
     std::vector<df::coord2d> geoidx;
     std::vector<std::vector<int16_t> > layer_mats;
     validgeo = Maps::ReadGeology(&layer_mats, &geoidx);
@@ -1304,33 +1330,37 @@ bool MapExtras::MapCache::removeItemOnGround(df::item *item) {
 
 bool MapExtras::MapCache::WriteAll()
 {
-    auto world = df::global::world;
-    df::job_list_link* job_link = world->jobs.list.next;
-    df::job_list_link* next = nullptr;
-    for (;job_link;job_link = next) {
-        next = job_link->next;
-        df::job* job = job_link->item;
-        df::coord pos = job->pos;
-        df::coord blockpos(pos.x>>4,pos.y>>4,pos.z);
-        auto iter = blocks.find(blockpos);
-        if (iter == blocks.end())
-            continue;
-        df::coord2d bpos(pos.x - (blockpos.x<<4),pos.y - (blockpos.y<<4));
-        auto block = iter->second;
-        if (!block->designated_tiles.test(bpos.x+bpos.y*16))
-            continue;
-        bool is_designed = ENUM_ATTR(job_type,is_designation,job->job_type);
-        if (!is_designed)
-            continue;
-        // Remove designation job. DF will create a new one in the next tick
-        // processing.
-        Job::removeJob(job);
+    // Existing designation jobs on re-designated tiles are removed; DF will
+    // create a new one in the next tick processing. The job list is only
+    // walked when some tile was actually designated.
+    if (designated_count > 0)
+    {
+        auto world = df::global::world;
+        std::vector<df::job*> stale;
+        for (auto job_link = world->jobs.list.next; job_link; job_link = job_link->next)
+        {
+            df::job* job = job_link->item;
+            if (!ENUM_ATTR(job_type,is_designation,job->job_type))
+                continue;
+            df::coord pos = job->pos;
+            auto block = blocks.find(pos.x>>4, pos.y>>4, pos.z);
+            if (block && block->designated_tiles.test((pos.x&15) + (pos.y&15)*16))
+                stale.push_back(job);
+        }
+        for (auto job : stale)
+            Job::removeJob(job);
     }
-    std::map<DFCoord, Block *>::iterator p;
-    for(p = blocks.begin(); p != blocks.end(); p++)
+
+    // Only blocks that were modified need to be written back; Write()
+    // itself only copies the layers that are dirty.
+    for (auto block : dirty_blocks)
     {
-        p->second->Write();
+        block->Write();
+        block->queued_write = false;
+        block->designated_tiles.reset();
     }
+    dirty_blocks.clear();
+    designated_count = 0;
     return true;
 }
 
@@ -1338,36 +1368,25 @@ MapExtras::Block *MapExtras::MapCache::BlockAt(DFCoord blockcoord)
 {
     if(!valid)
         return 0;
-    std::map <DFCoord, Block*>::iterator iter = blocks.find(blockcoord);
-    if(iter != blocks.end())
-    {
-        return (*iter).second;
-    }
-    else
-    {
-        if(unsigned(blockcoord.x) < x_bmax &&
-           unsigned(blockcoord.y) < y_bmax &&
-           unsigned(blockcoord.z) < z_max)
-        {
-            Block * nblo = new Block(this, blockcoord);
-            blocks[blockcoord] = nblo;
-            return nblo;
-        }
-        return 0;
-    }
+    if (Block *block = blocks.find(blockcoord.x, blockcoord.y, blockcoord.z))
+        return block;
+    return blocks.emplace(blockcoord.x, blockcoord.y, blockcoord.z, this, blockcoord);
 }
 
 void MapExtras::MapCache::discardBlock(Block *block)
 {
-    blocks.erase(block->bcoord);
-    delete block;
+    if (block->queued_write)
+    {
+        dirty_blocks.erase(std::remove(dirty_blocks.begin(), dirty_blocks.end(), block), dirty_blocks.end());
+        designated_count -= block->designated_tiles.count();
+    }
+    blocks.erase(block->bcoord.x, block->bcoord.y, block->bcoord.z);
 }
 
 void MapExtras::MapCache::resetTags()
 {
-    for (auto it = blocks.begin(); it != blocks.end(); ++it)
-    {
-        delete[] it->second->tags;
-        it->second->tags = NULL;
-    }
+    blocks.for_each([](Block *block) {
+        delete[] block->tags;
+        block->tags = NULL;
+    });
 }
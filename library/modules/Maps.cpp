@@ -67,8 +67,12 @@ distribution.
 #include <vector>
 #include <map>
 #include <set>
+#include <atomic>
 #include <cstdlib>
+#include <exception>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 using std::max;
 using std::min;
@@ -227,6 +231,58 @@ bool Maps::IsValid() {
     return (world->map.block_index != NULL);
 }
 
+size_t Maps::getParallelWorkerCount()
+{
+    static const size_t MAX_WORKERS = 16;
+    size_t count = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min(count, MAX_WORKERS));
+}
+
+void Maps::parallelForBlock(const cuboid &box,
+    std::function<void(df::map_block *, const cuboid &, size_t)> fn)
+{
+    auto c = box;
+    if (!c.clampMap().isValid())
+        return;
+
+    // Gather the work on the calling thread; block lookup is cheap.
+    vector<std::pair<df::map_block *, cuboid>> work;
+    c.forBlock([&](df::map_block *block, cuboid intersect) {
+        work.emplace_back(block, intersect);
+        return true;
+    });
+    if (work.empty())
+        return;
+
+    size_t num_workers = std::min(getParallelWorkerCount(), work.size());
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto run = [&](size_t worker) {
+        try {
+            for (size_t i = next++; i < work.size() && !failed; i = next++)
+                fn(work[i].first, work[i].second, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    };
+
+    vector<std::thread> threads;
+    for (size_t i = 1; i < num_workers; i++)
+        threads.emplace_back(run, i);
+    run(0);
+    for (auto &thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
 void Maps::forCoord(std::function<bool(df::coord)> fn, int16_t x1, int16_t y1, int16_t z1,
     int16_t x2, int16_t y2, int16_t z2)
 {
@@ -25,6 +25,7 @@ distribution.
 #include "Core.h"
 #include "Debug.h"
 #include "Internal.h"
+#include "KeyIndex.h"
 #include "LuaTools.h"
 
 #include "modules/Filesystem.h"
@@ -33,31 +34,139 @@ distribution.
 #include "modules/World.h"
 
 #include <json/json.h>
-
+#include <zlib.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace DFHack {
     DBG_DECLARE(core, persistence, DebugCategory::LINFO);
 }
 
 using namespace DFHack;
 
-static std::unordered_map<int, std::multimap<std::string, std::shared_ptr<Persistence::DataEntry>>> store;
+// items of each entity, indexed by key
+typedef KeyIndex<PersistentDataItem> EntityStore;
+static std::unordered_map<int, EntityStore> store;
 static std::unordered_map<size_t, std::shared_ptr<Persistence::DataEntry>> entry_cache;
 
+// Snapshot of an entity store that has not changed since it was last
+// loaded or saved. Once a snapshot is handed to the writer thread, only
+// the writer touches file_data, and the written_* fields are guarded by
+// the mutex.
+struct EncodedStore {
+    uint32_t count = 0;
+    std::string payload;
+    std::string file_data;
+
+    std::mutex mutex;
+    std::string written_path;
+    int64_t written_mtime = -1;
+    size_t written_size = 0;
+};
+static std::unordered_map<int, std::shared_ptr<EncodedStore>> encoded_stores;
+
+static void mark_dirty(int entity_id) {
+    CoreSuspender suspend;
+    encoded_stores.erase(entity_id);
+}
+
+/*
+ * Binary store format. All integers are little-endian.
+ *
+ *   header:  "DFHP", uint8 version, uint8 flags, uint16 reserved,
+ *            uint32 record count, uint32 uncompressed payload size
+ *   payload: records, zlib-compressed if (flags & BINARY_FLAG_ZLIB)
+ *   record:  uint32 length of the rest of the record,
+ *            uint16 key length, key, int32 fake_df_id,
+ *            uint32 string length, string, uint8 int count, int32 ints
+ *
+ * Files that do not start with the magic are read as the older JSON format.
+ */
+static const char BINARY_MAGIC[4] = { 'D', 'F', 'H', 'P' };
+static const uint8_t BINARY_VERSION = 1;
+static const uint8_t BINARY_FLAG_ZLIB = 1;
+static const size_t BINARY_HEADER_SIZE = 16;
+static const size_t COMPRESS_THRESHOLD = 64 * 1024;
+
+namespace {
+    void put_u8(std::string &buf, uint8_t val) {
+        buf.push_back(char(val));
+    }
+    void put_u16(std::string &buf, uint16_t val) {
+        put_u8(buf, uint8_t(val));
+        put_u8(buf, uint8_t(val >> 8));
+    }
+    void put_u32(std::string &buf, uint32_t val) {
+        put_u16(buf, uint16_t(val));
+        put_u16(buf, uint16_t(val >> 16));
+    }
+    void set_u32(std::string &buf, size_t pos, uint32_t val) {
+        for (size_t i = 0; i < 4; i++)
+            buf[pos + i] = char(uint8_t(val >> (8 * i)));
+    }
+
+    struct Reader {
+        const uint8_t *pos;
+        const uint8_t *end;
+        bool ok = true;
+
+        Reader(const void *data, size_t size)
+            : pos((const uint8_t *)data), end((const uint8_t *)data + size) {}
+
+        bool has(size_t n) {
+            if (ok && size_t(end - pos) < n)
+                ok = false;
+            return ok;
+        }
+        uint8_t u8() {
+            return has(1) ? *pos++ : 0;
+        }
+        uint16_t u16() {
+            uint16_t lo = u8();
+            return lo | uint16_t(u8() << 8);
+        }
+        uint32_t u32() {
+            uint32_t lo = u16();
+            return lo | (uint32_t(u16()) << 16);
+        }
+        void str(std::string &out, size_t len) {
+            if (!has(len))
+                return;
+            out.assign((const char *)pos, len);
+            pos += len;
+        }
+    };
+}
+
 size_t next_entry_id = 0;   // goes more positive
 int next_fake_df_id = -101; // goes more negative
 
 struct Persistence::DataEntry {
     const size_t entry_id;
     const int entity_id;
-    const std::string key;
+    const std::string &key; // interned in the entity store
     int fake_df_id;
     std::string str_value;
     std::array<int, PersistentDataItem::NumInts> int_values;
 
     explicit DataEntry(int entity_id, const std::string &key)
-    : entry_id(next_entry_id++), entity_id(entity_id), key(key) {
+    : entry_id(next_entry_id++), entity_id(entity_id), key(store[entity_id].intern(key)) {
         fake_df_id = 0;
         for (size_t i = 0; i < PersistentDataItem::NumInts; i++)
             int_values.at(i) = -1;
@@ -74,30 +183,45 @@ struct Persistence::DataEntry {
         }
     }
 
-    Json::Value toJSON() const {
-        Json::Value json(Json::objectValue);
-        json["k"] = key;
-        if (fake_df_id < 0)
-            json["f"] = fake_df_id;
-        if (str_value.size())
-            json["s"] = str_value;
+    // reads the rest of a record after the key
+    explicit DataEntry(int entity_id, const std::string &key, Reader &in)
+    : DataEntry(entity_id, key) {
+        fake_df_id = int32_t(in.u32());
+        in.str(str_value, in.u32());
+        size_t num_ints = in.u8();
+        for (size_t i = 0; i < num_ints; i++) {
+            int32_t val = int32_t(in.u32());
+            if (i < PersistentDataItem::NumInts)
+                int_values.at(i) = val;
+        }
+    }
+
+    void encode(std::string &buf) const {
+        size_t start = buf.size();
+        put_u32(buf, 0);
+        put_u16(buf, uint16_t(key.size()));
+        buf.append(key, 0, uint16_t(key.size()));
+        put_u32(buf, uint32_t(fake_df_id < 0 ? fake_df_id : 0));
+        put_u32(buf, uint32_t(str_value.size()));
+        buf.append(str_value);
         size_t num_set_ints = 0;
         for (size_t i = 0; i < PersistentDataItem::NumInts; i++) {
             if (int_values.at(i) != -1)
                 num_set_ints = i + 1;
         }
-        if (num_set_ints) {
-            Json::Value ints(Json::arrayValue);
-            for (size_t i = 0; i < num_set_ints; i++)
-                ints.append(int_values.at(i));
-            json["i"] = std::move(ints);
-        }
-        return json;
+        put_u8(buf, uint8_t(num_set_ints));
+        for (size_t i = 0; i < num_set_ints; i++)
+            put_u32(buf, uint32_t(int_values.at(i)));
+        set_u32(buf, start, uint32_t(buf.size() - start - 4));
     }
 
-    bool isReferencedBy(const PersistentDataItem & item) {
+    bool isReferencedBy(const PersistentDataItem & item) const {
         return item.data.get() == this;
     }
+
+    static const DataEntry *of(const PersistentDataItem & item) {
+        return item.data.get();
+    }
 };
 
 int PersistentDataItem::entity_id() const {
@@ -111,9 +235,11 @@ const std::string &PersistentDataItem::key() const
     return data->key;
 }
 
+// the mutable accessors conservatively assume that the caller will write
 std::string &PersistentDataItem::val()
 {
     CHECK_INVALID_ARGUMENT(isValid());
+    mark_dirty(data->entity_id);
     return data->str_value;
 }
 const std::string &PersistentDataItem::val() const
@@ -125,6 +251,7 @@ int &PersistentDataItem::ival(int i)
 {
     CHECK_INVALID_ARGUMENT(isValid());
     CHECK_INVALID_ARGUMENT(i >= 0 && i < (int)NumInts);
+    mark_dirty(data->entity_id);
     return data->int_values.at(i);
 }
 int PersistentDataItem::ival(int i) const
@@ -134,7 +261,14 @@ int PersistentDataItem::ival(int i) const
     return data->int_values.at(i);
 }
 
-const std::string & PersistentDataItem::get_str() {
+void PersistentDataItem::markDirty()
+{
+    // a deleted item has already marked its store
+    if (data)
+        mark_dirty(data->entity_id);
+}
+
+const std::string & PersistentDataItem::get_str() const {
     static const std::string empty;
     return isValid() ? val() : empty;
 }
@@ -154,8 +288,10 @@ int PersistentDataItem::fake_df_id() {
         return 0;
 
     // set it if unset
-    if (data->fake_df_id == 0)
+    if (data->fake_df_id == 0) {
         data->fake_df_id = next_fake_df_id--;
+        mark_dirty(data->entity_id);
+    }
 
     return data->fake_df_id;
 }
@@ -163,8 +299,12 @@ int PersistentDataItem::fake_df_id() {
 void Persistence::Internal::clear(color_ostream& out) {
     CoreSuspender suspend;
 
+    // don't let writes for the previous world race with the new one
+    flush();
+
     store.clear();
     entry_cache.clear();
+    encoded_stores.clear();
     next_entry_id = 0;
     next_fake_df_id = -101;
 }
@@ -185,6 +325,155 @@ static std::string getSaveFilePath(const std::string &world, const std::string &
     return getSavePath(world) + "/dfhack-" + filterSaveFileName(name) + ".dat";
 }
 
+static std::shared_ptr<EncodedStore> encode_store(const EntityStore &entries) {
+    auto encoded = std::make_shared<EncodedStore>();
+    entries.for_each([&](const PersistentDataItem &item) {
+        Persistence::DataEntry::of(item)->encode(encoded->payload);
+        ++encoded->count;
+    });
+    return encoded;
+}
+
+static std::string build_store_file(const EncodedStore &encoded) {
+    const std::string &payload = encoded.payload;
+    std::string buf(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    put_u8(buf, BINARY_VERSION);
+    uint8_t flags = payload.size() >= COMPRESS_THRESHOLD ? BINARY_FLAG_ZLIB : 0;
+    put_u8(buf, flags);
+    put_u16(buf, 0);
+    put_u32(buf, encoded.count);
+    put_u32(buf, uint32_t(payload.size()));
+
+    if (flags & BINARY_FLAG_ZLIB) {
+        uLongf len = compressBound(uLong(payload.size()));
+        buf.resize(BINARY_HEADER_SIZE + len);
+        if (compress2((Bytef *)&buf[BINARY_HEADER_SIZE], &len,
+                (const Bytef *)payload.data(), uLong(payload.size()), Z_BEST_SPEED) == Z_OK) {
+            buf.resize(BINARY_HEADER_SIZE + len);
+            return buf;
+        }
+        // fall back to storing uncompressed
+        buf.resize(BINARY_HEADER_SIZE);
+        buf[5] = 0;
+    }
+    buf.append(payload);
+    return buf;
+}
+
+// Writes to a temporary file, syncs it to disk, and renames it over the
+// target, so a crash mid-save never leaves a truncated file behind.
+static bool write_file_atomic(const std::string &path, const std::string &data) {
+    std::string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size() && fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = fclose(f) == 0 && ok;
+    if (ok) {
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, path, ec);
+        ok = !ec;
+    }
+    if (!ok)
+        remove(tmp_path.c_str());
+    return ok;
+}
+
+namespace {
+    // Thread that compresses and writes the store files for a save, so one
+    // file is written while the simulation thread encodes the next.
+    // Core::doUpdate waits for it before DF continues with its own save.
+    class SaveWriter {
+        std::mutex mutex;
+        std::condition_variable work_cv;
+        std::condition_variable idle_cv;
+        std::deque<std::function<void()>> jobs;
+        bool busy = false;
+        bool stopping = false;
+        std::thread thread;
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                work_cv.wait(lock, [&]{ return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    break;
+                auto job = std::move(jobs.front());
+                jobs.pop_front();
+                busy = true;
+                lock.unlock();
+                job();
+                lock.lock();
+                busy = false;
+                if (jobs.empty())
+                    idle_cv.notify_all();
+            }
+        }
+
+    public:
+        ~SaveWriter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            work_cv.notify_all();
+            if (thread.joinable())
+                thread.join();
+        }
+
+        void enqueue(std::function<void()> job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!thread.joinable())
+                thread = std::thread(&SaveWriter::run, this);
+            jobs.push_back(std::move(job));
+            work_cv.notify_one();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle_cv.wait(lock, [&]{ return jobs.empty() && !busy; });
+        }
+    };
+
+    SaveWriter save_writer;
+}
+
+// true if the file we wrote for this snapshot last time is still there
+static bool is_written(EncodedStore &encoded, const std::string &path) {
+    std::lock_guard<std::mutex> lock(encoded.mutex);
+    if (encoded.written_path != path || encoded.written_mtime == -1 || !Filesystem::isfile(path))
+        return false;
+    STAT_STRUCT info;
+    return Filesystem::mtime(path) == encoded.written_mtime &&
+        Filesystem::stat(path, info) && size_t(info.st_size) == encoded.written_size;
+}
+
+// runs on the writer thread
+static void write_store_file(EncodedStore &encoded, const std::string &path) {
+    if (encoded.file_data.empty()) {
+        encoded.file_data = build_store_file(encoded);
+        std::string().swap(encoded.payload);
+    }
+
+    bool ok = write_file_atomic(path, encoded.file_data);
+
+    std::lock_guard<std::mutex> lock(encoded.mutex);
+    if (!ok) {
+        ERR(persistence).print("Cannot write data to: '%s'\n", path.c_str());
+        encoded.written_path.clear();
+        encoded.written_mtime = -1;
+        return;
+    }
+    encoded.written_path = path;
+    encoded.written_mtime = Filesystem::mtime(path);
+    encoded.written_size = encoded.file_data.size();
+}
+
 void Persistence::Internal::save(color_ostream& out) {
     if (!Core::getInstance().isWorldLoaded())
         return;
@@ -193,25 +482,35 @@ void Persistence::Internal::save(color_ostream& out) {
 
     for (auto & entity_store_entry : store) {
         int entity_id = entity_store_entry.first;
-        Json::Value json(Json::arrayValue);
-        for (auto & entries : entity_store_entry.second) {
-            if (entries.second == nullptr)
-                continue;
-            json.append(entries.second->toJSON());
-        }
+        auto & encoded = encoded_stores[entity_id];
+        if (!encoded)
+            encoded = encode_store(entity_store_entry.second);
         std::string name = (entity_id == Persistence::WORLD_ENTITY_ID) ?
             "world" : "entity-" + int_to_string(entity_id);
-        auto file = std::ofstream(getSaveFilePath("current", name));
-        file << json;
+        std::string path = getSaveFilePath("current", name);
+        if (is_written(*encoded, path))
+            continue;
+        save_writer.enqueue([encoded, path]() { write_store_file(*encoded, path); });
     }
 
     {
-        auto file = std::ofstream(getSaveFilePath("current", "perf-counters"));
-        color_ostream_wrapper wrapper(file);
+        std::ostringstream ss;
+        color_ostream_wrapper wrapper(ss);
         Lua::CallLuaModuleFunction(wrapper, "script-manager", "print_timers");
+        wrapper.flush();
+        std::string path = getSaveFilePath("current", "perf-counters");
+        save_writer.enqueue([path, text = ss.str()]() {
+            if (!write_file_atomic(path, text)) {
+                ERR(persistence).print("Cannot write data to: '%s'\n", path.c_str());
+            }
+        });
     }
 }
 
+void Persistence::Internal::flush() {
+    save_writer.wait();
+}
+
 static bool get_entity_id(const std::string & fname, int & entity_id) {
     if (!fname.starts_with("dfhack-entity-"))
         return false;
@@ -219,9 +518,8 @@ static bool get_entity_id(const std::string & fname, int & entity_id) {
     return true;
 }
 
-static void add_entry(std::multimap<std::string, std::shared_ptr<Persistence::DataEntry>> & entity_store_entry,
-        std::shared_ptr<Persistence::DataEntry> entry) {
-    entity_store_entry.emplace(entry->key, entry);
+static void add_entry(EntityStore & entity_store_entry, std::shared_ptr<Persistence::DataEntry> entry) {
+    entity_store_entry.add(entry->key, PersistentDataItem(entry));
     entry_cache.emplace(entry->entry_id, entry);
 }
 
@@ -229,10 +527,67 @@ static void add_entry(int entity_id, std::shared_ptr<Persistence::DataEntry> ent
     add_entry(store[entity_id], entry);
 }
 
-static bool load_file(const std::string & path, int entity_id) {
+static void add_loaded_entry(EntityStore & entity_store_entry, std::shared_ptr<Persistence::DataEntry> entry) {
+    if (entry->key.empty())
+        return;
+    // ensure fake DF IDs remain globally unique
+    next_fake_df_id = std::min(next_fake_df_id, entry->fake_df_id - 1);
+    add_entry(entity_store_entry, entry);
+}
+
+static bool load_binary(const std::string & data, int entity_id) {
+    Reader header(data.data(), data.size());
+    if (!header.has(BINARY_HEADER_SIZE))
+        return false;
+    header.pos += sizeof(BINARY_MAGIC);
+    uint8_t version = header.u8();
+    uint8_t flags = header.u8();
+    header.u16();
+    uint32_t count = header.u32();
+    uint32_t payload_size = header.u32();
+    if (version != BINARY_VERSION)
+        return false;
+
+    std::string inflated;
+    const char *payload = data.data() + BINARY_HEADER_SIZE;
+    if (flags & BINARY_FLAG_ZLIB) {
+        inflated.resize(payload_size);
+        uLongf len = payload_size;
+        if (uncompress((Bytef *)&inflated[0], &len, (const Bytef *)payload,
+                uLong(data.size() - BINARY_HEADER_SIZE)) != Z_OK || len != payload_size)
+            return false;
+        payload = inflated.data();
+    } else if (data.size() - BINARY_HEADER_SIZE != payload_size) {
+        return false;
+    }
+
+    // decode everything before adding anything, so a corrupt file is all-or-nothing
+    std::vector<std::shared_ptr<Persistence::DataEntry>> entries;
+    entries.reserve(std::min<size_t>(count, payload_size / 4));
+    Reader in(payload, payload_size);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t len = in.u32();
+        if (!in.has(len))
+            return false;
+        Reader rec(in.pos, len);
+        in.pos += len;
+        std::string key;
+        rec.str(key, rec.u16());
+        entries.emplace_back(new Persistence::DataEntry(entity_id, key, rec));
+        if (!rec.ok)
+            return false;
+    }
+
+    auto & entity_store_entry = store[entity_id];
+    for (auto & entry : entries)
+        add_loaded_entry(entity_store_entry, entry);
+    return true;
+}
+
+static bool load_json(const std::string & data, int entity_id) {
     Json::Value json;
     try {
-        std::ifstream file(path);
+        std::istringstream file(data);
         file >> json;
     } catch (std::exception &) {
         // empty file?
@@ -241,16 +596,38 @@ static bool load_file(const std::string & path, int entity_id) {
 
     if (json.isArray()) {
         auto & entity_store_entry = store[entity_id];
-        for (auto & value : json) {
-            std::shared_ptr<Persistence::DataEntry> entry(new Persistence::DataEntry(entity_id, value));
-            if (entry->key.empty())
-                continue;
-            // ensure fake DF IDs remain globally unique
-            next_fake_df_id = std::min(next_fake_df_id, entry->fake_df_id - 1);
-            add_entry(entity_store_entry, entry);
-        }
+        for (auto & value : json)
+            add_loaded_entry(entity_store_entry, std::shared_ptr<Persistence::DataEntry>(new Persistence::DataEntry(entity_id, value)));
+    }
+
+    return true;
+}
+
+static bool load_file(const std::string & path, int entity_id) {
+    std::string data;
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        std::ostringstream ss;
+        ss << file.rdbuf();
+        data = ss.str();
     }
 
+    if (data.size() < sizeof(BINARY_MAGIC) || memcmp(data.data(), BINARY_MAGIC, sizeof(BINARY_MAGIC)))
+        return load_json(data, entity_id); // converted to the binary format on next save
+
+    if (!load_binary(data, entity_id)) {
+        // don't leave behind an empty store that would overwrite the file
+        auto it = store.find(entity_id);
+        if (it != store.end() && it->second.empty())
+            store.erase(it);
+        return false;
+    }
+    // unchanged stores can be written back as-is
+    auto encoded = std::make_shared<EncodedStore>();
+    encoded->file_data = std::move(data);
+    encoded_stores[entity_id] = encoded;
     return true;
 }
 
@@ -305,6 +682,7 @@ PersistentDataItem Persistence::addItem(int entity_id, const std::string &key) {
 
     auto ptr = std::shared_ptr<DataEntry>(new DataEntry(entity_id, key));
     add_entry(entity_id, ptr);
+    mark_dirty(entity_id);
     return PersistentDataItem(ptr);
 }
 
@@ -314,11 +692,14 @@ PersistentDataItem Persistence::getByKey(int entity_id, const std::string &key,
 
     CoreSuspender suspend;
 
-    bool found = store.contains(entity_id) && store[entity_id].contains(key);
+    const PersistentDataItem *found = NULL;
+    auto it = store.find(entity_id);
+    if (it != store.end())
+        found = it->second.find(key);
     if (added)
         *added = !found;
     if (found)
-        return PersistentDataItem(store[entity_id].find(key)->second);
+        return *found;
     if (!added)
         return PersistentDataItem();
     return addItem(entity_id, key);
@@ -331,63 +712,63 @@ bool Persistence::deleteItem(const PersistentDataItem &item) {
     CoreSuspender suspend;
 
     int entity_id = item.entity_id();
+    auto entry = DataEntry::of(item);
 
-    auto range = store[entity_id].equal_range(item.key());
-    for (auto it = range.first; it != range.second; ++it) {
-        if (it->second->isReferencedBy(item)) {
-            entry_cache.erase(it->second->entry_id);
-            store[entity_id].erase(it);
-            break;
-        }
-    }
+    store[entity_id].erase_if(item.key(), [&](const PersistentDataItem &other) {
+        return entry->isReferencedBy(other);
+    });
+    entry_cache.erase(entry->entry_id);
+    mark_dirty(entity_id);
     return true;
 }
 
+static const EntityStore *get_entity_store(int entity_id) {
+    if (!is_good_entity_id(entity_id) || !Core::getInstance().isWorldLoaded())
+        return NULL;
+    auto it = store.find(entity_id);
+    return it == store.end() ? NULL : &it->second;
+}
+
 void Persistence::getAll(std::vector<PersistentDataItem> &vec, int entity_id) {
     vec.clear();
 
-    if (!is_good_entity_id(entity_id) || !Core::getInstance().isWorldLoaded())
-        return;
-
     CoreSuspender suspend;
 
-    if (!store.contains(entity_id))
-        return;
-
-    for (auto & entries : store[entity_id])
-        vec.emplace_back(entries.second);
+    if (auto entries = get_entity_store(entity_id)) {
+        vec.reserve(entries->size());
+        entries->for_each([&](const PersistentDataItem &item) { vec.push_back(item); });
+    }
 }
 
 void Persistence::getAllByKeyRange(std::vector<PersistentDataItem> &vec, int entity_id,
         const std::string &min, const std::string &max) {
     vec.clear();
+    forEachByKeyRange(entity_id, min, max, [&](const PersistentDataItem &item) { vec.push_back(item); });
+}
 
-    if (!is_good_entity_id(entity_id) || !Core::getInstance().isWorldLoaded())
-        return;
+void Persistence::getAllByKey(std::vector<PersistentDataItem> &vec, int entity_id, const std::string &key) {
+    vec.clear();
 
     CoreSuspender suspend;
 
-    if (!store.contains(entity_id))
-        return;
-
-    auto begin = store[entity_id].lower_bound(min);
-    auto end = store[entity_id].lower_bound(max);
-    for (auto it = begin; it != end; ++it)
-        vec.emplace_back(it->second);
+    if (auto entries = get_entity_store(entity_id)) {
+        vec.reserve(entries->count_key(key));
+        entries->for_each_key(key, [&](const PersistentDataItem &item) { vec.push_back(item); });
+    }
 }
 
-void Persistence::getAllByKey(std::vector<PersistentDataItem> &vec, int entity_id, const std::string &key) {
-    vec.clear();
+void Persistence::forEachByKey(int entity_id, const std::string &key,
+        const std::function<void(const PersistentDataItem &)> &fn) {
+    CoreSuspender suspend;
 
-    if (!is_good_entity_id(entity_id) || !Core::getInstance().isWorldLoaded())
-        return;
+    if (auto entries = get_entity_store(entity_id))
+        entries->for_each_key(key, fn);
+}
 
+void Persistence::forEachByKeyRange(int entity_id, const std::string &min, const std::string &max,
+        const std::function<void(const PersistentDataItem &)> &fn) {
     CoreSuspender suspend;
 
-    if (!store.contains(entity_id))
-        return;
-
-    auto range = store[entity_id].equal_range(key);
-    for (auto it = range.first; it != range.second; ++it)
-        vec.emplace_back(it->second);
+    if (auto entries = get_entity_store(entity_id))
+        entries->for_each_range(min, max, fn);
 }
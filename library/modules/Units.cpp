@@ -662,14 +662,107 @@ bool Units::isUnitInBox(df::unit *u, const cuboid &box) {
     return box.containsPos(getPosition(u));
 }
 
+/*
+ * Spatial index of active units, bucketed by map block. Entries are sorted by
+ * (z, block y, block x), so the units in one row of blocks are a contiguous
+ * range. Tools can move units at any time, paused or not, by writing their
+ * position directly, so before each query the index compares every active
+ * unit's position with the one it was indexed at and is rebuilt on any
+ * difference. That check is a plain walk over the active list, much cheaper
+ * than running the filter on every unit, and keeps the results exactly equal
+ * to the linear scan.
+ */
+namespace {
+    struct UnitIndexEntry {
+        uint64_t key;
+        size_t active_idx;
+        bool operator<(const UnitIndexEntry &other) const {
+            return key < other.key || (key == other.key && active_idx < other.active_idx);
+        }
+    };
+
+    struct UnitSpatialIndex {
+        bool valid = false;
+        vector<df::unit *> units;
+        vector<df::coord> positions;
+        vector<UnitIndexEntry> entries;
+
+        static uint64_t make_key(int16_t x, int16_t y, int16_t z) {
+            return (uint64_t(uint16_t(z)) << 32) | (uint64_t(uint16_t(y >> 4)) << 16) | uint16_t(x >> 4);
+        }
+
+        void invalidate() { valid = false; }
+
+        bool is_current() const {
+            auto &active = world->units.active;
+            if (!valid || units.size() != active.size())
+                return false;
+            for (size_t i = 0; i < active.size(); i++)
+                if (units[i] != active[i] || positions[i] != Units::getPosition(active[i]))
+                    return false;
+            return true;
+        }
+
+        void rebuild() {
+            auto &active = world->units.active;
+            units.assign(active.begin(), active.end());
+            positions.clear();
+            positions.reserve(active.size());
+            entries.clear();
+            entries.reserve(active.size());
+            for (size_t i = 0; i < active.size(); i++) {
+                df::coord pos = Units::getPosition(active[i]);
+                positions.push_back(pos);
+                if (!pos.isValid())
+                    continue;
+                entries.push_back({make_key(pos.x, pos.y, pos.z), i});
+            }
+            std::sort(entries.begin(), entries.end());
+            valid = true;
+        }
+    };
+}
+
+static UnitSpatialIndex unit_index;
+
 bool Units::getUnitsInBox(vector<df::unit *> &units, const cuboid &box, std::function<bool(df::unit *)> filter) {
     if (!world)
         return false;
 
     units.clear();
-    for (auto unit : world->units.active)
-        if (filter(unit) && isUnitInBox(unit, box))
+    auto &active = world->units.active;
+
+    // the index pays off when the box spans fewer block rows than there are units
+    size_t rows = box.isValid() ? size_t(box.z_max - box.z_min + 1) * ((box.y_max >> 4) - (box.y_min >> 4) + 1) : 0;
+    if (!box.isValid() || rows > active.size()) {
+        for (auto unit : active)
+            if (filter(unit) && isUnitInBox(unit, box))
+                units.push_back(unit);
+        return true;
+    }
+
+    if (!unit_index.is_current())
+        unit_index.rebuild();
+
+    vector<size_t> found;
+    auto &entries = unit_index.entries;
+    for (int16_t z = box.z_min; z <= box.z_max; z++) {
+        for (int16_t by = box.y_min >> 4; by <= box.y_max >> 4; by++) {
+            auto first = std::lower_bound(entries.begin(), entries.end(),
+                UnitIndexEntry{UnitSpatialIndex::make_key(box.x_min, by << 4, z), 0});
+            uint64_t last_key = UnitSpatialIndex::make_key(box.x_max, by << 4, z);
+            for (auto it = first; it != entries.end() && it->key <= last_key; ++it)
+                found.push_back(it->active_idx);
+        }
+    }
+
+    // report units in the same order as the linear scan would
+    std::sort(found.begin(), found.end());
+    for (size_t idx : found) {
+        auto unit = active[idx];
+        if (isUnitInBox(unit, box) && filter(unit))
             units.push_back(unit);
+    }
     return true;
 }
 
@@ -753,6 +846,7 @@ df::coord Units::getPosition(df::unit *unit) {
 
 bool Units::teleport(df::unit *unit, df::coord target_pos)
 {   // Make sure source and dest map blocks are valid
+    unit_index.invalidate();
     auto old_occ = Maps::getTileOccupancy(unit->pos);
     auto new_occ = Maps::getTileOccupancy(target_pos);
     if (!old_occ || !new_occ)
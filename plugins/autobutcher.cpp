@@ -271,7 +271,7 @@ public:
     }
 
     WatchedRace(color_ostream &out, const PersistentDataItem &p)
-        : WatchedRace(out, p.ival(0), p.ival(1), p.ival(2), p.ival(3), p.ival(4), p.ival(5)) {
+        : WatchedRace(out, p.get_int(0), p.get_int(1), p.get_int(2), p.get_int(3), p.get_int(4), p.get_int(5)) {
         rconfig = p;
     }
 
@@ -285,12 +285,12 @@ public:
             rconfig = World::GetPersistentSiteData(keyname, true);
         }
         if(rconfig.isValid()) {
-            rconfig.ival(0) = raceId;
-            rconfig.ival(1) = isWatched;
-            rconfig.ival(2) = fk;
-            rconfig.ival(3) = mk;
-            rconfig.ival(4) = fa;
-            rconfig.ival(5) = ma;
+            rconfig.set_int(0, raceId);
+            rconfig.set_int(1, isWatched);
+            rconfig.set_int(2, fk);
+            rconfig.set_int(3, mk);
+            rconfig.set_int(4, fa);
+            rconfig.set_int(5, ma);
         }
         else {
             ERR(control,out).print("could not create persistent key for race: %s",
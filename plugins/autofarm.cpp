@@ -362,19 +362,19 @@ public:
 
         cfg_enabled = World::GetPersistentSiteData("autofarm/enabled");
         if (cfg_enabled.isValid())
-            enabled = cfg_enabled.ival(0) != 0;
+            enabled = cfg_enabled.get_int(0) != 0;
         else {
             cfg_enabled = World::AddPersistentSiteData("autofarm/enabled");
-            cfg_enabled.ival(0) = enabled;
+            cfg_enabled.set_int(0, enabled);
         }
 
         cfg_default_threshold = World::GetPersistentSiteData("autofarm/default_threshold");
 
         if (cfg_default_threshold.isValid())
-            defaultThreshold = cfg_default_threshold.ival(0);
+            defaultThreshold = cfg_default_threshold.get_int(0);
         else {
             cfg_default_threshold = World::AddPersistentSiteData("autofarm/default_threshold");
-            cfg_default_threshold.ival(0) = defaultThreshold;
+            cfg_default_threshold.set_int(0, defaultThreshold);
         }
 
         std::vector<PersistentDataItem> items;
@@ -383,8 +383,8 @@ public:
             if (i.isValid())
             {
                 const auto allPlants = world->raws.plants.all;
-                const std::string id = i.val();
-                const int val = i.ival(0);
+                const std::string id = i.get_str();
+                const int val = i.get_int(0);
                 const auto plant = std::find_if(std::begin(allPlants), std::end(allPlants), [id](df::plant_raw* p) { return p->id == id; });
                 if (plant != std::end(allPlants))
                 {
@@ -402,8 +402,8 @@ public:
 
     void save_state(color_ostream& out)
     {
-        cfg_default_threshold.ival(0) = defaultThreshold;
-        cfg_enabled.ival(0) = enabled;
+        cfg_default_threshold.set_int(0, defaultThreshold);
+        cfg_enabled.set_int(0, enabled);
 
         std::vector<PersistentDataItem> items;
         World::GetPersistentSiteData(&items, "autofarm/threshold/", true);
@@ -415,8 +415,8 @@ public:
             const std::string& plantID = world->raws.plants.all[t.first]->id;
             const std::string keyName = "autofarm/threshold/" + plantID;
             PersistentDataItem cfgThreshold = World::AddPersistentSiteData(keyName);
-            cfgThreshold.val() = plantID;
-            cfgThreshold.ival(0) = t.second;
+            cfgThreshold.set_str(plantID);
+            cfgThreshold.set_int(0, t.second);
         }
     }
 
@@ -254,7 +254,7 @@ struct autogem_hook : public df::viewscreen_dwarfmodest {
             // Toggle whether gems are auto-cut for this fort.
             auto config = World::GetPersistentData(CONFIG_KEY, NULL);
             if (config.isValid()) {
-                config.ival(0) = running;
+                config.set_int(0, running);
             }
 
             running = !running;
@@ -342,7 +342,7 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
         if (enabled && World::isFortressMode()) {
             // Determine whether auto gem cutting has been disabled for this fort.
             auto config = World::GetPersistentData(CONFIG_KEY);
-            running = config.isValid() && !config.ival(0);
+            running = config.isValid() && !config.get_int(0);
             read_config(out);
         }
     } else if (event == DFHack::SC_MAP_UNLOADED) {
@@ -82,7 +82,7 @@ command_result autolabor (color_ostream &out, std::vector <std::string> & parame
 
 static bool isOptionEnabled(unsigned flag)
 {
-    return config.isValid() && (config.ival(0) & flag) != 0;
+    return config.isValid() && (config.get_int(0) & flag) != 0;
 }
 
 enum ConfigFlags {
@@ -95,9 +95,9 @@ static void setOptionEnabled(ConfigFlags flag, bool on)
         return;
 
     if (on)
-        config.ival(0) |= flag;
+        config.set_int(0, config.get_int(0) | flag);
     else
-        config.ival(0) &= ~flag;
+        config.set_int(0, config.get_int(0) & ~flag);
 }
 
 
@@ -116,18 +116,18 @@ struct labor_info
     bool is_exclusive;
     int active_dwarfs;
 
-    labor_mode mode() { return (labor_mode) config.ival(0); }
+    labor_mode mode() { return (labor_mode) config.get_int(0); }
 
-    void set_mode(labor_mode mode) { config.ival(0) = mode; }
+    void set_mode(labor_mode mode) { config.set_int(0, mode); }
 
-    int minimum_dwarfs() { return config.ival(1); }
-    void set_minimum_dwarfs(int minimum_dwarfs) { config.ival(1) = minimum_dwarfs; }
+    int minimum_dwarfs() { return config.get_int(1); }
+    void set_minimum_dwarfs(int minimum_dwarfs) { config.set_int(1, minimum_dwarfs); }
 
-    int maximum_dwarfs() { return config.ival(2); }
-    void set_maximum_dwarfs(int maximum_dwarfs) { config.ival(2) = maximum_dwarfs; }
+    int maximum_dwarfs() { return config.get_int(2); }
+    void set_maximum_dwarfs(int maximum_dwarfs) { config.set_int(2, maximum_dwarfs); }
 
-    int talent_pool() { return config.ival(3); }
-    void set_talent_pool(int talent_pool) { config.ival(3) = talent_pool; }
+    int talent_pool() { return config.get_int(3); }
+    void set_talent_pool(int talent_pool) { config.set_int(3, talent_pool); }
 };
 
 struct labor_default
@@ -309,8 +309,8 @@ static void reset_labor(df::unit_labor labor)
 static void init_state()
 {
     config = World::GetPersistentSiteData("autolabor/config");
-    if (config.isValid() && config.ival(0) == -1)
-        config.ival(0) = 0;
+    if (config.isValid() && config.get_int(0) == -1)
+        config.set_int(0, 0);
 
     enable_autolabor = isOptionEnabled(CF_ENABLED);
 
@@ -323,7 +323,7 @@ static void init_state()
     auto cfg_haulpct = World::GetPersistentSiteData("autolabor/haulpct");
     if (cfg_haulpct.isValid())
     {
-        hauler_pct = cfg_haulpct.ival(0);
+        hauler_pct = cfg_haulpct.get_int(0);
     }
     else
     {
@@ -398,7 +398,7 @@ static void enable_plugin(color_ostream &out)
     if (!config.isValid())
     {
         config = World::AddPersistentSiteData("autolabor/config");
-        config.ival(0) = 0;
+        config.set_int(0, 0);
     }
 
     setOptionEnabled(CF_ENABLED, true);
@@ -126,21 +126,21 @@ struct labor_info
     int idle_dwarfs;
     int busy_dwarfs;
 
-    int priority() const { return config.ival(1); }
-    void set_priority(int priority) { config.ival(1) = priority; }
+    int priority() const { return config.get_int(1); }
+    void set_priority(int priority) { config.set_int(1, priority); }
 
     bool is_unmanaged() const { return maximum_dwarfs() == MAX_DWARFS_UNMANAGED; }
-    int maximum_dwarfs() const { return config.ival(2); }
-    void set_maximum_dwarfs(int maximum_dwarfs) { config.ival(2) = maximum_dwarfs; }
+    int maximum_dwarfs() const { return config.get_int(2); }
+    void set_maximum_dwarfs(int maximum_dwarfs) { config.set_int(2, maximum_dwarfs); }
 
     int time_since_last_assigned() const
     {
-        return (*df::global::cur_year - config.ival(3)) * 403200 + *df::global::cur_year_tick - config.ival(4);
+        return (*df::global::cur_year - config.get_int(3)) * 403200 + *df::global::cur_year_tick - config.get_int(4);
     }
 
     void mark_assigned() {
-        config.ival(3) = (*df::global::cur_year);
-        config.ival(4) = (*df::global::cur_year_tick);
+        config.set_int(3, (*df::global::cur_year));
+        config.set_int(4, (*df::global::cur_year_tick));
     }
 
 };
@@ -307,7 +307,7 @@ static bool initialized = false;
 
 static bool isOptionEnabled(unsigned flag)
 {
-    return config.isValid() && (config.ival(0) & flag) != 0;
+    return config.isValid() && (config.get_int(0) & flag) != 0;
 }
 
 static void setOptionEnabled(ConfigFlags flag, bool on)
@@ -316,9 +316,9 @@ static void setOptionEnabled(ConfigFlags flag, bool on)
         return;
 
     if (on)
-        config.ival(0) |= flag;
+        config.set_int(0, config.get_int(0) | flag);
     else
-        config.ival(0) &= ~flag;
+        config.set_int(0, config.get_int(0) & ~flag);
 }
 
 static void cleanup_state()
@@ -337,8 +337,8 @@ static void reset_labor(df::unit_labor labor)
 static void init_state()
 {
     config = World::GetPersistentData("labormanager/2.0/config");
-    if (config.isValid() && config.ival(0) == -1)
-        config.ival(0) = 0;
+    if (config.isValid() && config.get_int(0) == -1)
+        config.set_int(0, 0);
 
     enable_labormanager = isOptionEnabled(CF_ENABLED);
 
@@ -554,7 +554,7 @@ static void enable_plugin(color_ostream &out)
     if (!config.isValid())
     {
         config = World::AddPersistentData("labormanager/2.0/config");
-        config.ival(0) = 0;
+        config.set_int(0, 0);
     }
 
     setOptionEnabled(CF_ENABLED, true);
@@ -171,16 +171,16 @@ namespace CSP {
     void SaveSettings() {
         if (pfeature.isValid() && psetting.isValid()) {
             try {
-                pfeature.ival(MONITOR) = config.monitoring;
-                pfeature.ival(VISION) = config.require_vision;
-                pfeature.ival(INSTADIG) = false; //config.insta_dig;
-                pfeature.ival(RESURRECT) = config.resurrect;
-                pfeature.ival(RISKAVERSE) = config.riskaverse;
-
-                psetting.ival(REFRESH_RATE) = config.refresh_freq;
-                psetting.ival(MONITOR_RATE) = config.monitor_freq;
-                psetting.ival(IGNORE_THRESH) = config.ignore_threshold;
-                psetting.ival(FALL_THRESH) = config.fall_threshold;
+                pfeature.set_int(MONITOR, config.monitoring);
+                pfeature.set_int(VISION, config.require_vision);
+                pfeature.set_int(INSTADIG, false); //config.insta_dig;
+                pfeature.set_int(RESURRECT, config.resurrect);
+                pfeature.set_int(RISKAVERSE, config.riskaverse);
+
+                psetting.set_int(REFRESH_RATE, config.refresh_freq);
+                psetting.set_int(MONITOR_RATE, config.monitor_freq);
+                psetting.set_int(IGNORE_THRESH, config.ignore_threshold);
+                psetting.set_int(FALL_THRESH, config.fall_threshold);
             } catch (std::exception &e) {
                 ERR(plugin).print("%s\n", e.what());
             }
@@ -197,16 +197,16 @@ namespace CSP {
             SaveSettings();
         } else {
             try {
-                config.monitoring = pfeature.ival(MONITOR);
-                config.require_vision = pfeature.ival(VISION);
-                config.insta_dig = false; //pfeature.ival(INSTADIG);
-                config.resurrect = pfeature.ival(RESURRECT);
-                config.riskaverse = pfeature.ival(RISKAVERSE);
-
-                config.ignore_threshold = psetting.ival(IGNORE_THRESH);
-                config.fall_threshold = psetting.ival(FALL_THRESH);
-                config.refresh_freq = psetting.ival(REFRESH_RATE);
-                config.monitor_freq = psetting.ival(MONITOR_RATE);
+                config.monitoring = pfeature.get_int(MONITOR);
+                config.require_vision = pfeature.get_int(VISION);
+                config.insta_dig = false; //pfeature.get_int(INSTADIG);
+                config.resurrect = pfeature.get_int(RESURRECT);
+                config.riskaverse = pfeature.get_int(RISKAVERSE);
+
+                config.ignore_threshold = psetting.get_int(IGNORE_THRESH);
+                config.fall_threshold = psetting.get_int(FALL_THRESH);
+                config.refresh_freq = psetting.get_int(REFRESH_RATE);
+                config.monitor_freq = psetting.get_int(MONITOR_RATE);
             } catch (std::exception &e) {
                 ERR(plugin).print("%s\n", e.what());
             }
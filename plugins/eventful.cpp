@@ -29,6 +29,7 @@
 #include <string.h>
 #include <stdexcept>
 #include <array>
+#include <unordered_map>
 
 using std::vector;
 using std::string;
@@ -37,6 +38,9 @@ using namespace DFHack;
 using namespace df::enums;
 
 DFHACK_PLUGIN("eventful");
+// only set while batched events are in use, so the per-frame update that
+// delivers them is skipped otherwise
+DFHACK_PLUGIN_IS_ENABLED(is_enabled);
 REQUIRE_GLOBAL(gps);
 REQUIRE_GLOBAL(world);
 REQUIRE_GLOBAL(plotinfo);
@@ -111,6 +115,53 @@ DEFINE_LUA_EVENT_NH_3(onUnitAttack, int32_t, int32_t, int32_t);
 DEFINE_LUA_EVENT_NH_0(onUnload);
 DEFINE_LUA_EVENT_NH_6(onInteraction, std::string, std::string, int32_t, int32_t, int32_t, int32_t);
 
+/*
+ * Batched event manager events: all occurrences seen during a tick are
+ * collected and delivered to Lua as one array from plugin_onupdate.
+ */
+namespace batch {
+    struct SyndromeRecord { int32_t unit_id; int32_t syndrome_index; };
+    struct InventoryRecord { int32_t unit_id; int32_t item_id; };
+    struct AttackRecord { int32_t attacker; int32_t defender; int32_t wound; };
+
+    static void Push(lua_State *L, const SyndromeRecord &rec) {
+        lua_createtable(L, 0, 2);
+        Lua::TableInsert(L, "unit_id", rec.unit_id);
+        Lua::TableInsert(L, "syndrome_index", rec.syndrome_index);
+    }
+    static void Push(lua_State *L, const InventoryRecord &rec) {
+        lua_createtable(L, 0, 2);
+        Lua::TableInsert(L, "unit_id", rec.unit_id);
+        Lua::TableInsert(L, "item_id", rec.item_id);
+    }
+    static void Push(lua_State *L, const AttackRecord &rec) {
+        lua_createtable(L, 0, 3);
+        Lua::TableInsert(L, "attacker", rec.attacker);
+        Lua::TableInsert(L, "defender", rec.defender);
+        Lua::TableInsert(L, "wound", rec.wound);
+    }
+
+    // jobs are queued by id, since plugins updating before us may cancel
+    // them; they are looked up again when the batch is delivered
+    static std::vector<int32_t> jobInitiated, jobStarted;
+    static std::vector<int32_t> unitNewActive, unitDeath, itemCreated, building, invasion, report;
+    static std::vector<SyndromeRecord> syndrome;
+    static std::vector<InventoryRecord> inventoryChange;
+    static std::vector<AttackRecord> unitAttack;
+}
+
+DEFINE_LUA_EVENT_NH_1(onJobInitiatedBatch, const std::vector<df::job*> &);
+DEFINE_LUA_EVENT_NH_1(onJobStartedBatch, const std::vector<df::job*> &);
+DEFINE_LUA_EVENT_NH_1(onUnitNewActiveBatch, const std::vector<int32_t> &);
+DEFINE_LUA_EVENT_NH_1(onUnitDeathBatch, const std::vector<int32_t> &);
+DEFINE_LUA_EVENT_NH_1(onItemCreatedBatch, const std::vector<int32_t> &);
+DEFINE_LUA_EVENT_NH_1(onBuildingCreatedDestroyedBatch, const std::vector<int32_t> &);
+DEFINE_LUA_EVENT_NH_1(onInvasionBatch, const std::vector<int32_t> &);
+DEFINE_LUA_EVENT_NH_1(onReportBatch, const std::vector<int32_t> &);
+DEFINE_LUA_EVENT_NH_1(onSyndromeBatch, const std::vector<batch::SyndromeRecord> &);
+DEFINE_LUA_EVENT_NH_1(onInventoryChangeBatch, const std::vector<batch::InventoryRecord> &);
+DEFINE_LUA_EVENT_NH_1(onUnitAttackBatch, const std::vector<batch::AttackRecord> &);
+
 DFHACK_PLUGIN_LUA_EVENTS {
     DFHACK_LUA_EVENT(onWorkshopFillSidebarMenu),
     DFHACK_LUA_EVENT(postWorkshopFillSidebarMenu),
@@ -137,6 +188,18 @@ DFHACK_PLUGIN_LUA_EVENTS {
     DFHACK_LUA_EVENT(onUnitAttack),
     DFHACK_LUA_EVENT(onUnload),
     DFHACK_LUA_EVENT(onInteraction),
+    /*  batched event manager events */
+    DFHACK_LUA_EVENT(onJobInitiatedBatch),
+    DFHACK_LUA_EVENT(onJobStartedBatch),
+    DFHACK_LUA_EVENT(onUnitNewActiveBatch),
+    DFHACK_LUA_EVENT(onUnitDeathBatch),
+    DFHACK_LUA_EVENT(onItemCreatedBatch),
+    DFHACK_LUA_EVENT(onBuildingCreatedDestroyedBatch),
+    DFHACK_LUA_EVENT(onInvasionBatch),
+    DFHACK_LUA_EVENT(onReportBatch),
+    DFHACK_LUA_EVENT(onSyndromeBatch),
+    DFHACK_LUA_EVENT(onInventoryChangeBatch),
+    DFHACK_LUA_EVENT(onUnitAttackBatch),
     DFHACK_LUA_END
 };
 
@@ -221,7 +284,111 @@ static void ev_mng_interaction(color_ostream& out, void* ptr) {
     EventManager::InteractionData* data = (EventManager::InteractionData*)ptr;
     onInteraction(out, data->attackVerb, data->defendVerb, data->attacker, data->defender, data->attackReport, data->defendReport);
 }
+
+template<std::vector<int32_t> *queue>
+static void ev_batch_job(color_ostream& out, void* ptr)
+{
+    queue->push_back(reinterpret_cast<df::job*>(ptr)->id);
+}
+template<std::vector<int32_t> *queue>
+static void ev_batch_id(color_ostream& out, void* ptr)
+{
+    queue->push_back((int32_t)(intptr_t)ptr);
+}
+static void ev_batch_syndrome(color_ostream& out, void* ptr)
+{
+    auto data = reinterpret_cast<EventManager::SyndromeData*>(ptr);
+    batch::syndrome.push_back({data->unitId, data->syndromeIndex});
+}
+static void ev_batch_inventory(color_ostream& out, void* ptr)
+{
+    // the old and new inventory entries do not outlive the handler call,
+    // so only the ids are kept
+    auto data = reinterpret_cast<EventManager::InventoryChangeData*>(ptr);
+    int32_t itemId = -1;
+    if (data->item_old)
+        itemId = data->item_old->itemId;
+    if (data->item_new)
+        itemId = data->item_new->itemId;
+    batch::inventoryChange.push_back({data->unitId, itemId});
+}
+static void ev_batch_unitAttack(color_ostream& out, void* ptr)
+{
+    auto data = reinterpret_cast<EventManager::UnitAttackData*>(ptr);
+    batch::unitAttack.push_back({data->attacker, data->defender, data->wound});
+}
+
+template<typename T>
+static void flush_batch(color_ostream &out, std::vector<T> &queue,
+                        void (*event)(color_ostream &, const std::vector<T> &))
+{
+    if (queue.empty())
+        return;
+    // swap out first, in case a callback causes more events to be queued
+    std::vector<T> items;
+    items.swap(queue);
+    event(out, items);
+}
+
+// jobs that no longer exist by the time the batch is delivered are dropped
+static void flush_job_batch(color_ostream &out, std::vector<int32_t> &queue,
+                            void (*event)(color_ostream &, const std::vector<df::job*> &))
+{
+    if (queue.empty())
+        return;
+    std::vector<int32_t> ids;
+    ids.swap(queue);
+
+    std::unordered_map<int32_t, df::job*> live;
+    for (auto id : ids)
+        live[id] = NULL;
+    for (auto job : world->jobs.list) {
+        auto it = live.find(job->id);
+        if (it != live.end())
+            it->second = job;
+    }
+
+    std::vector<df::job*> jobs;
+    for (auto id : ids) {
+        if (df::job *job = live[id])
+            jobs.push_back(job);
+    }
+    if (!jobs.empty())
+        event(out, jobs);
+}
+
+static void flush_batches(color_ostream &out)
+{
+    flush_job_batch(out, batch::jobInitiated, onJobInitiatedBatch);
+    flush_job_batch(out, batch::jobStarted, onJobStartedBatch);
+    flush_batch(out, batch::unitNewActive, onUnitNewActiveBatch);
+    flush_batch(out, batch::unitDeath, onUnitDeathBatch);
+    flush_batch(out, batch::itemCreated, onItemCreatedBatch);
+    flush_batch(out, batch::building, onBuildingCreatedDestroyedBatch);
+    flush_batch(out, batch::invasion, onInvasionBatch);
+    flush_batch(out, batch::report, onReportBatch);
+    flush_batch(out, batch::syndrome, onSyndromeBatch);
+    flush_batch(out, batch::inventoryChange, onInventoryChangeBatch);
+    flush_batch(out, batch::unitAttack, onUnitAttackBatch);
+}
+
+static void clear_batches()
+{
+    batch::jobInitiated.clear();
+    batch::jobStarted.clear();
+    batch::unitNewActive.clear();
+    batch::unitDeath.clear();
+    batch::itemCreated.clear();
+    batch::building.clear();
+    batch::invasion.clear();
+    batch::report.clear();
+    batch::syndrome.clear();
+    batch::inventoryChange.clear();
+    batch::unitAttack.clear();
+}
+
 std::vector<int> enabledEventManagerEvents(EventManager::EventType::EVENT_MAX,-1);
+std::vector<int> enabledBatchedEvents(EventManager::EventType::EVENT_MAX,-1);
 typedef void (*handler_t) (color_ostream&,void*);
 
 using namespace EventManager::EventType;
@@ -268,37 +435,108 @@ handler_t getManager(EventType t) {
     return nullptr;
 }
 
-std::array<handler_t,EventManager::EventType::EVENT_MAX> compileEventHandlerArray() {
+// events whose payload does not outlive the handler call cannot be batched
+handler_t getBatchManager(EventType t) {
+    switch (t) {
+        case JOB_INITIATED:
+            return ev_batch_job<&batch::jobInitiated>;
+        case JOB_STARTED:
+            return ev_batch_job<&batch::jobStarted>;
+        case UNIT_NEW_ACTIVE:
+            return ev_batch_id<&batch::unitNewActive>;
+        case UNIT_DEATH:
+            return ev_batch_id<&batch::unitDeath>;
+        case ITEM_CREATED:
+            return ev_batch_id<&batch::itemCreated>;
+        case BUILDING:
+            return ev_batch_id<&batch::building>;
+        case INVASION:
+            return ev_batch_id<&batch::invasion>;
+        case REPORT:
+            return ev_batch_id<&batch::report>;
+        case SYNDROME:
+            return ev_batch_syndrome;
+        case INVENTORY_CHANGE:
+            return ev_batch_inventory;
+        case UNIT_ATTACK:
+            return ev_batch_unitAttack;
+        case TICK:
+        case JOB_COMPLETED:
+        case CONSTRUCTION:
+        case UNLOAD:
+        case INTERACTION:
+        case EVENT_MAX:
+            return nullptr;
+    }
+    return nullptr;
+}
+
+std::array<handler_t,EventManager::EventType::EVENT_MAX> compileEventHandlerArray(handler_t (*get)(EventType)) {
     std::array<handler_t, EventManager::EventType::EVENT_MAX> managers{};
     auto t = (EventManager::EventType::EventType) 0;
     while (t < EventManager::EventType::EVENT_MAX) {
-        managers[t] = getManager(t);
+        managers[t] = get(t);
         t = (EventManager::EventType::EventType) int(t + 1);
     }
     return managers;
 }
 static std::array<handler_t,EventManager::EventType::EVENT_MAX> eventHandlers;
+static std::array<handler_t,EventManager::EventType::EVENT_MAX> batchHandlers;
 
-static void enableEvent(int evType,int freq)
+static void enableHandler(int evType, int freq, EventManager::EventHandler::callback_t fun_ptr, std::vector<int> &enabled)
 {
-    if (freq < 0)
-        return;
-    CHECK_INVALID_ARGUMENT(evType >= 0 && evType < EventManager::EventType::EVENT_MAX &&
-                           evType != EventManager::EventType::TICK);
-    EventManager::EventHandler::callback_t fun_ptr = eventHandlers[evType];
     EventManager::EventType::EventType typeToEnable=static_cast<EventManager::EventType::EventType>(evType);
 
-    int oldFreq = enabledEventManagerEvents[typeToEnable];
+    int oldFreq = enabled[typeToEnable];
     if (oldFreq != -1) {
         if (freq >= oldFreq)
             return;
         EventManager::unregister(typeToEnable,EventManager::EventHandler(plugin_self,fun_ptr,oldFreq));
     }
     EventManager::registerListener(typeToEnable,EventManager::EventHandler(plugin_self,fun_ptr,freq));
-    enabledEventManagerEvents[typeToEnable] = freq;
+    enabled[typeToEnable] = freq;
+}
+
+static void enableEvent(int evType,int freq)
+{
+    if (freq < 0)
+        return;
+    CHECK_INVALID_ARGUMENT(evType >= 0 && evType < EventManager::EventType::EVENT_MAX &&
+                           evType != EventManager::EventType::TICK);
+    enableHandler(evType, freq, eventHandlers[evType], enabledEventManagerEvents);
+}
+
+static void enableBatchedEvent(int evType,int freq)
+{
+    if (freq < 0)
+        return;
+    CHECK_INVALID_ARGUMENT(evType >= 0 && evType < EventManager::EventType::EVENT_MAX &&
+                           batchHandlers[evType]);
+    enableHandler(evType, freq, batchHandlers[evType], enabledBatchedEvents);
+    is_enabled = true;
+}
+
+static void disableBatchedEvent(int evType)
+{
+    CHECK_INVALID_ARGUMENT(evType >= 0 && evType < EventManager::EventType::EVENT_MAX &&
+                           batchHandlers[evType]);
+    int freq = enabledBatchedEvents[evType];
+    if (freq == -1)
+        return;
+    EventManager::unregister(static_cast<EventManager::EventType::EventType>(evType),
+                             EventManager::EventHandler(plugin_self,batchHandlers[evType],freq));
+    enabledBatchedEvents[evType] = -1;
+
+    for (int f : enabledBatchedEvents)
+        if (f != -1)
+            return;
+    is_enabled = false;
+    clear_batches();
 }
 DFHACK_PLUGIN_LUA_FUNCTIONS{
     DFHACK_LUA_FUNCTION(enableEvent),
+    DFHACK_LUA_FUNCTION(enableBatchedEvent),
+    DFHACK_LUA_FUNCTION(disableBatchedEvent),
     DFHACK_LUA_END
 };
 struct workshop_hook : df::building_workshopst{
@@ -508,7 +746,7 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
         break;
     case SC_WORLD_UNLOADED:
         world_specific_hooks(out,false);
-
+        clear_batches();
         break;
     default:
         break;
@@ -517,9 +755,17 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
     return CR_OK;
 }
 
+// EventManager runs before plugin updates, so this sees the whole tick
+DFhackCExport command_result plugin_onupdate(color_ostream &out)
+{
+    flush_batches(out);
+    return CR_OK;
+}
+
 DFhackCExport command_result plugin_init ( color_ostream &out, std::vector <PluginCommand> &commands)
 {
-    eventHandlers = compileEventHandlerArray();
+    eventHandlers = compileEventHandlerArray(getManager);
+    batchHandlers = compileEventHandlerArray(getBatchManager);
     if (Core::getInstance().isWorldLoaded())
         plugin_onstatechange(out, SC_WORLD_LOADED);
     enable_hooks(true);
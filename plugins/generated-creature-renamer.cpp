@@ -104,7 +104,7 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
     std::vector<int> descriptorCount = std::vector<int>(descriptors.size());
 
     auto version = World::GetPersistentData("AlreadyRenamedCreatures");
-    if (version.isValid() && version.ival(1) >= RENAMER_VERSION)
+    if (version.isValid() && version.get_int(1) >= RENAMER_VERSION)
     {
         return CR_OK;
     }
@@ -169,7 +169,7 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
     }
 
     version = World::AddPersistentData("AlreadyRenamedCreatures");
-    version.ival(1) = RENAMER_VERSION;
+    version.set_int(1, RENAMER_VERSION);
 
     out << "Renamed " << creatureCount << " generated creatures to have sensible names." << endl;
 
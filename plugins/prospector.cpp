@@ -33,6 +33,7 @@
 #include <map>
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include <vector>
 
 using std::string;
@@ -119,6 +120,14 @@ struct matdata
         }
         return count;
     }
+    void merge(const matdata &other)
+    {
+        count += other.count;
+        if (other.lower_z != invalid_z && (lower_z == invalid_z || other.lower_z < lower_z))
+            lower_z = other.lower_z;
+        if (other.upper_z != invalid_z && (upper_z == invalid_z || other.upper_z > upper_z))
+            upper_z = other.upper_z;
+    }
     float count;
     int lower_z;
     int upper_z;
@@ -144,6 +153,44 @@ struct shallower
 typedef std::map<int16_t, matdata> MatMap;
 typedef std::vector< std::pair<int16_t, matdata> > MatSorter;
 
+static void mergeMats(MatMap &dest, const MatMap &src)
+{
+    for (auto &entry : src)
+        dest[entry.first].merge(entry.second);
+}
+
+// Results of scanning part of the map; one per worker thread.
+struct prospect_data
+{
+    bool hasDemonTemple = false;
+    bool hasLair = false;
+    MatMap baseMats;
+    MatMap layerMats;
+    MatMap veinMats;
+    MatMap plantMats;
+    MatMap treeMats;
+
+    matdata liquidWater;
+    matdata liquidMagma;
+    matdata aquiferTiles;
+    matdata tubeTiles;
+
+    void merge(const prospect_data &other)
+    {
+        hasDemonTemple = hasDemonTemple || other.hasDemonTemple;
+        hasLair = hasLair || other.hasLair;
+        mergeMats(baseMats, other.baseMats);
+        mergeMats(layerMats, other.layerMats);
+        mergeMats(veinMats, other.veinMats);
+        mergeMats(plantMats, other.plantMats);
+        mergeMats(treeMats, other.treeMats);
+        liquidWater.merge(other.liquidWater);
+        liquidMagma.merge(other.liquidMagma);
+        aquiferTiles.merge(other.aquiferTiles);
+        tubeTiles.merge(other.tubeTiles);
+    }
+};
+
 typedef std::vector<df::plant *> PlantList;
 
 #define TO_PTR_VEC(obj_vec, ptr_vec) \
@@ -629,184 +676,202 @@ static command_result map_prospector(color_ostream &con,
         return CR_FAILURE;
     }
 
-    uint32_t x_max = 0, y_max = 0, z_max = 0;
-    Maps::getSize(x_max, y_max, z_max);
-    MapExtras::MapCache map;
-
     DFHack::Materials *mats = Core::getInstance().getMaterials();
 
-    DFHack::t_feature blockFeatureGlobal;
-    DFHack::t_feature blockFeatureLocal;
-
-    bool hasDemonTemple = false;
-    bool hasLair = false;
-    MatMap baseMats;
-    MatMap layerMats;
-    MatMap veinMats;
-    MatMap plantMats;
-    MatMap treeMats;
+    // Blocks are scanned in parallel; each worker accumulates into its own
+    // results and MapCache, which are merged below.
+    size_t num_workers = Maps::getParallelWorkerCount();
+    vector<prospect_data> results(num_workers);
+    vector<std::unique_ptr<MapExtras::MapCache>> caches(num_workers);
+    for (auto &cache : caches)
+        cache.reset(new MapExtras::MapCache());
 
-    matdata liquidWater;
-    matdata liquidMagma;
-    matdata aquiferTiles;
-    matdata tubeTiles;
+    uint32_t x_max = 0, y_max = 0, z_max = 0;
+    Maps::getSize(x_max, y_max, z_max);
+    cuboid all_tiles(0, 0, 0, int16_t(x_max * 16 - 1), int16_t(y_max * 16 - 1), int16_t(z_max - 1));
 
-    for(uint32_t z = 0; z < z_max; z++)
+    Maps::parallelForBlock(all_tiles, [&](df::map_block *block, const cuboid &, size_t worker)
     {
+        auto &data = results[worker];
+        auto &map = *caches[worker];
+        auto &hasDemonTemple = data.hasDemonTemple;
+        auto &hasLair = data.hasLair;
+        auto &baseMats = data.baseMats;
+        auto &layerMats = data.layerMats;
+        auto &veinMats = data.veinMats;
+        auto &plantMats = data.plantMats;
+        auto &treeMats = data.treeMats;
+        auto &liquidWater = data.liquidWater;
+        auto &liquidMagma = data.liquidMagma;
+        auto &aquiferTiles = data.aquiferTiles;
+        auto &tubeTiles = data.tubeTiles;
+
+        DFHack::t_feature blockFeatureGlobal;
+        DFHack::t_feature blockFeatureLocal;
+
+        df::coord bcoord(block->map_pos.x >> 4, block->map_pos.y >> 4, block->map_pos.z);
         // the '- 100' is because DF v50 and later have a 100 offset in reported elevation
-        int global_z = world->map.region_z + z - 100;
+        int global_z = world->map.region_z + bcoord.z - 100;
 
-        for(uint32_t b_y = 0; b_y < y_max; b_y++)
+        // Get the map block
+        MapExtras::Block *b = map.BlockAt(bcoord);
+        if (!b || !b->is_valid())
+            return;
+
+        // Find features
+        b->GetGlobalFeature(&blockFeatureGlobal);
+        b->GetLocalFeature(&blockFeatureLocal);
+
+        // Iterate over all the tiles in the block
+        for(uint32_t y = 0; y < 16; y++)
         {
-            for(uint32_t b_x = 0; b_x < x_max; b_x++)
+            for(uint32_t x = 0; x < 16; x++)
             {
-                // Get the map block
-                df::coord2d blockCoord(b_x, b_y);
-                MapExtras::Block *b = map.BlockAt(DFHack::DFCoord(b_x, b_y, z));
-                if (!b || !b->is_valid())
+                df::coord2d coord(x, y);
+                df::tile_designation des = b->DesignationAt(coord);
+                df::tile_occupancy occ = b->OccupancyAt(coord);
+
+                // Skip hidden tiles
+                if (!options.hidden && des.bits.hidden)
                 {
                     continue;
                 }
 
-                // Find features
-                b->GetGlobalFeature(&blockFeatureGlobal);
-                b->GetLocalFeature(&blockFeatureLocal);
-
-                // Iterate over all the tiles in the block
-                for(uint32_t y = 0; y < 16; y++)
+                // Check for aquifer
+                if (des.bits.water_table)
                 {
-                    for(uint32_t x = 0; x < 16; x++)
-                    {
-                        df::coord2d coord(x, y);
-                        df::tile_designation des = b->DesignationAt(coord);
-                        df::tile_occupancy occ = b->OccupancyAt(coord);
+                    aquiferTiles.add(global_z);
+                }
 
-                        // Skip hidden tiles
-                        if (!options.hidden && des.bits.hidden)
-                        {
-                            continue;
-                        }
+                // Check for lairs
+                if (occ.bits.monster_lair)
+                {
+                    hasLair = true;
+                }
 
-                        // Check for aquifer
-                        if (des.bits.water_table)
-                        {
-                            aquiferTiles.add(global_z);
-                        }
+                // Check for liquid
+                if (des.bits.flow_size)
+                {
+                    if (des.bits.liquid_type == tile_liquid::Magma)
+                        liquidMagma.add(global_z);
+                    else
+                        liquidWater.add(global_z);
+                }
 
-                        // Check for lairs
-                        if (occ.bits.monster_lair)
-                        {
-                            hasLair = true;
-                        }
+                df::tiletype type = b->tiletypeAt(coord);
+                df::tiletype_shape tileshape = tileShape(type);
+                df::tiletype_material tilemat = tileMaterial(type);
 
-                        // Check for liquid
-                        if (des.bits.flow_size)
-                        {
-                            if (des.bits.liquid_type == tile_liquid::Magma)
-                                liquidMagma.add(global_z);
-                            else
-                                liquidWater.add(global_z);
-                        }
+                // We only care about these types
+                switch (tileshape)
+                {
+                case tiletype_shape::WALL:
+                case tiletype_shape::FORTIFICATION:
+                    break;
+                case tiletype_shape::EMPTY:
+                    /* A heuristic: tubes inside adamantine have EMPTY:AIR tiles which
+                       still have feature_local set. Also check the unrevealed status,
+                       so as to exclude any holes mined by the player. */
+                    if (tilemat == tiletype_material::AIR &&
+                        des.bits.feature_local && des.bits.hidden &&
+                        blockFeatureLocal.type == feature_type::deep_special_tube)
+                    {
+                        tubeTiles.add(global_z);
+                    }
+                default:
+                    continue;
+                }
 
-                        df::tiletype type = b->tiletypeAt(coord);
-                        df::tiletype_shape tileshape = tileShape(type);
-                        df::tiletype_material tilemat = tileMaterial(type);
+                // Count the material type
+                baseMats[tilemat].add(global_z);
 
-                        // We only care about these types
-                        switch (tileshape)
+                // Find the type of the tile
+                switch (tilemat)
+                {
+                case tiletype_material::SOIL:
+                case tiletype_material::STONE:
+                    layerMats[b->layerMaterialAt(coord)].add(global_z);
+                    break;
+                case tiletype_material::MINERAL:
+                    veinMats[b->veinMaterialAt(coord)].add(global_z);
+                    break;
+                case tiletype_material::FEATURE:
+                    if (blockFeatureLocal.type != -1 && des.bits.feature_local)
+                    {
+                        if (blockFeatureLocal.type == feature_type::deep_special_tube
+                                && blockFeatureLocal.main_material == 0) // stone
                         {
-                        case tiletype_shape::WALL:
-                        case tiletype_shape::FORTIFICATION:
-                            break;
-                        case tiletype_shape::EMPTY:
-                            /* A heuristic: tubes inside adamantine have EMPTY:AIR tiles which
-                               still have feature_local set. Also check the unrevealed status,
-                               so as to exclude any holes mined by the player. */
-                            if (tilemat == tiletype_material::AIR &&
-                                des.bits.feature_local && des.bits.hidden &&
-                                blockFeatureLocal.type == feature_type::deep_special_tube)
-                            {
-                                tubeTiles.add(global_z);
-                            }
-                        default:
-                            continue;
+                            veinMats[blockFeatureLocal.sub_material].add(global_z);
                         }
-
-                        // Count the material type
-                        baseMats[tilemat].add(global_z);
-
-                        // Find the type of the tile
-                        switch (tilemat)
+                        else if (blockFeatureLocal.type == feature_type::deep_surface_portal)
                         {
-                        case tiletype_material::SOIL:
-                        case tiletype_material::STONE:
-                            layerMats[b->layerMaterialAt(coord)].add(global_z);
-                            break;
-                        case tiletype_material::MINERAL:
-                            veinMats[b->veinMaterialAt(coord)].add(global_z);
-                            break;
-                        case tiletype_material::FEATURE:
-                            if (blockFeatureLocal.type != -1 && des.bits.feature_local)
-                            {
-                                if (blockFeatureLocal.type == feature_type::deep_special_tube
-                                        && blockFeatureLocal.main_material == 0) // stone
-                                {
-                                    veinMats[blockFeatureLocal.sub_material].add(global_z);
-                                }
-                                else if (blockFeatureLocal.type == feature_type::deep_surface_portal)
-                                {
-                                    hasDemonTemple = true;
-                                }
-                            }
-
-                            if (blockFeatureGlobal.type != -1 && des.bits.feature_global
-                                    && blockFeatureGlobal.type == feature_type::underworld_from_layer
-                                    && blockFeatureGlobal.main_material == 0) // stone
-                            {
-                                layerMats[blockFeatureGlobal.sub_material].add(global_z);
-                            }
-                            break;
-                        case tiletype_material::LAVA_STONE:
-                            // TODO ?
-                            break;
-                        default:
-                            break;
+                            hasDemonTemple = true;
                         }
                     }
+
+                    if (blockFeatureGlobal.type != -1 && des.bits.feature_global
+                            && blockFeatureGlobal.type == feature_type::underworld_from_layer
+                            && blockFeatureGlobal.main_material == 0) // stone
+                    {
+                        layerMats[blockFeatureGlobal.sub_material].add(global_z);
+                    }
+                    break;
+                case tiletype_material::LAVA_STONE:
+                    // TODO ?
+                    break;
+                default:
+                    break;
                 }
+            }
+        }
 
-                // Check plants this way, as the other way wasn't getting them all
-                // and we can check visibility more easily here
-                if (options.shrubs)
+        // Check plants this way, as the other way wasn't getting them all
+        // and we can check visibility more easily here
+        if (options.shrubs)
+        {
+            auto column = Maps::getBlockColumn(bcoord.x, bcoord.y);
+            vector<df::plant *> *plants = column ? &column->plants : NULL;
+            if(plants)
+            {
+                for (PlantList::const_iterator it = plants->begin(); it != plants->end(); it++)
                 {
-                    auto block = Maps::getBlockColumn(b_x,b_y);
-                    vector<df::plant *> *plants = block ? &block->plants : NULL;
-                    if(plants)
+                    const df::plant & plant = *(*it);
+                    if (plant.pos.z != bcoord.z)
+                        continue;
+                    df::coord2d loc(plant.pos.x, plant.pos.y);
+                    loc = loc % 16;
+                    if (options.hidden || !b->DesignationAt(loc).bits.hidden)
                     {
-                        for (PlantList::const_iterator it = plants->begin(); it != plants->end(); it++)
-                        {
-                            const df::plant & plant = *(*it);
-                            if (uint32_t(plant.pos.z) != z)
-                                continue;
-                            df::coord2d loc(plant.pos.x, plant.pos.y);
-                            loc = loc % 16;
-                            if (options.hidden || !b->DesignationAt(loc).bits.hidden)
-                            {
-                                if (ENUM_ATTR(plant_type, is_shrub, plant.type))
-                                    plantMats[plant.material].add(global_z);
-                                else
-                                    treeMats[plant.material].add(global_z);
-                            }
-                        }
+                        if (ENUM_ATTR(plant_type, is_shrub, plant.type))
+                            plantMats[plant.material].add(global_z);
+                        else
+                            treeMats[plant.material].add(global_z);
                     }
                 }
-                // Block end
-            } // block x
-
-            // Clean uneeded memory
-            map.trash();
-        } // block y
-    } // z
+            }
+        }
+        // Block end
+
+        // Clean uneeded memory
+        map.discardBlock(b);
+    });
+
+    prospect_data total;
+    for (auto &data : results)
+        total.merge(data);
+
+    bool hasDemonTemple = total.hasDemonTemple;
+    bool hasLair = total.hasLair;
+    MatMap &baseMats = total.baseMats;
+    MatMap &layerMats = total.layerMats;
+    MatMap &veinMats = total.veinMats;
+    MatMap &plantMats = total.plantMats;
+    MatMap &treeMats = total.treeMats;
+
+    matdata &liquidWater = total.liquidWater;
+    matdata &liquidMagma = total.liquidMagma;
+    matdata &aquiferTiles = total.aquiferTiles;
+    matdata &tubeTiles = total.tubeTiles;
 
     MatMap::const_iterator it;
 
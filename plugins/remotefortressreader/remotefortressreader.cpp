@@ -1,6 +1,7 @@
 #include "df_version_int.h"
 #define RFR_VERSION "0.21.0"
 
+#include <algorithm>
 #include <cstdio>
 #include <time.h>
 #include <vector>
@@ -160,8 +161,26 @@ static command_result GetUnitList(color_ostream &stream, const EmptyMessage *in,
 static command_result GetUnitListInside(color_ostream &stream, const BlockRequest *in, UnitList *out);
 static command_result GetViewInfo(color_ostream &stream, const EmptyMessage *in, ViewInfo *out);
 static command_result GetMapInfo(color_ostream &stream, const EmptyMessage *in, MapInfo *out);
-static command_result ResetMapHashes(color_ostream &stream, const EmptyMessage *in);
-static command_result GetWorldMap(color_ostream &stream, const EmptyMessage *in, WorldMap *out);
+struct WorldMapTile
+{
+    int16_t elevation, rainfall, vegetation, temperature, evilness;
+    int16_t drainage, volcanism, savagery, salinity, water_elevation;
+    uint8_t cirrus, cumulus, fog, front, stratus;
+};
+struct WorldMapSnapshot
+{
+    int width = 0;
+    int height = 0;
+    std::string name;
+    std::string name_english;
+    int poles = -1;
+    DFCoord center;
+    int32_t cur_year = 0;
+    int32_t cur_year_tick = 0;
+    std::vector<WorldMapTile> tiles;
+};
+static command_result SnapshotWorldMap(color_ostream &stream, const EmptyMessage *in, WorldMapSnapshot *stage);
+static command_result GetWorldMap(color_ostream &stream, const EmptyMessage *in, const WorldMapSnapshot *stage, WorldMap *out);
 static command_result GetWorldMapNew(color_ostream &stream, const EmptyMessage *in, WorldMap *out);
 static command_result GetWorldMapCenter(color_ostream &stream, const EmptyMessage *in, WorldMap *out);
 static command_result GetRegionMaps(color_ostream &stream, const EmptyMessage *in, RegionMaps *out);
@@ -170,7 +189,14 @@ static command_result GetCreatureRaws(color_ostream &stream, const EmptyMessage
 static command_result GetPartialCreatureRaws(color_ostream &stream, const ListRequest *in, CreatureRawList *out);
 static command_result GetPlantRaws(color_ostream &stream, const EmptyMessage *in, PlantRawList *out);
 static command_result GetPartialPlantRaws(color_ostream &stream, const ListRequest *in, PlantRawList *out);
-static command_result CopyScreen(color_ostream &stream, const EmptyMessage *in, ScreenCapture *out);
+struct ScreenSnapshot
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> screen;
+};
+static command_result SnapshotScreen(color_ostream &stream, const EmptyMessage *in, ScreenSnapshot *stage);
+static command_result CopyScreen(color_ostream &stream, const EmptyMessage *in, const ScreenSnapshot *stage, ScreenCapture *out);
 static command_result PassKeyboardEvent(color_ostream &stream, const KeyboardEvent *in);
 static command_result GetPauseState(color_ostream & stream, const EmptyMessage * in, SingleBool * out);
 static command_result GetVersionInfo(color_ostream & stream, const EmptyMessage * in, RemoteFortressReader::VersionInfo * out);
@@ -178,6 +204,51 @@ static command_result GetReports(color_ostream & stream, const EmptyMessage * in
 static command_result GetLanguage(color_ostream & stream, const EmptyMessage * in, RemoteFortressReader::Language * out);
 static command_result GetGameValidity(color_ostream &stream, const EmptyMessage * in, SingleBool *out);
 
+// Regions registered with SubscribeBlockList. Each subscriber keeps its own
+// hashes, so several clients watching overlapping regions don't steal each
+// other's changes the way they do with the shared GetBlockList hashes.
+struct SubscribedBlock
+{
+    uint16_t tiletype = 0;
+    uint16_t designation = 0;
+    uint16_t spatter = 0;
+    uint16_t building = 0;
+    uint16_t items = 0;
+};
+
+struct BlockSubscriber
+{
+    int min_x, max_x, min_y, max_y, min_z, max_z; // in blocks, max is exclusive
+    bool initialized = false;
+    std::vector<SubscribedBlock> blocks;
+};
+
+// One instance per client connection, so subscriptions are freed when the
+// connection closes.
+class BlockSubscriptionService : public RPCService
+{
+public:
+    static const size_t MAX_SUBSCRIPTIONS = 16;
+
+    BlockSubscriptionService()
+    {
+        addMethod("SubscribeBlockList", &BlockSubscriptionService::SubscribeBlockList, SF_ALLOW_REMOTE);
+        addMethod("GetBlockUpdates", &BlockSubscriptionService::GetBlockUpdates, SF_ALLOW_REMOTE);
+        addMethod("UnsubscribeBlockList", &BlockSubscriptionService::UnsubscribeBlockList, SF_ALLOW_REMOTE);
+        addMethod("ResetMapHashes", &BlockSubscriptionService::ResetMapHashes, SF_ALLOW_REMOTE);
+    }
+
+    command_result SubscribeBlockList(color_ostream &stream, const BlockRequest *in, RemoteFortressReader::BlockSubscription *out);
+    command_result GetBlockUpdates(color_ostream &stream, const RemoteFortressReader::BlockSubscription *in, BlockList *out);
+    command_result UnsubscribeBlockList(color_ostream &stream, const RemoteFortressReader::BlockSubscription *in);
+    // also resends everything for this connection's subscriptions
+    command_result ResetMapHashes(color_ostream &stream, const EmptyMessage *in);
+
+private:
+    std::map<int32_t, BlockSubscriber> subscribers;
+    int32_t next_id = 0;
+};
+
 void CopyBlock(df::map_block * DfBlock, RemoteFortressReader::MapBlock * NetBlock, MapExtras::MapCache * MC, DFCoord pos);
 
 const char* growth_locations[] = {
@@ -246,7 +317,7 @@ DFhackCExport command_result plugin_init(color_ostream &out, std::vector <Plugin
 
 DFhackCExport RPCService *plugin_rpcconnect(color_ostream &)
 {
-    RPCService *svc = new RPCService();
+    RPCService *svc = new BlockSubscriptionService();
     svc->addFunction("GetMaterialList", GetMaterialList, SF_ALLOW_REMOTE);
     svc->addFunction("GetGrowthList", GetGrowthList, SF_ALLOW_REMOTE);
     svc->addFunction("GetBlockList", GetBlockList, SF_ALLOW_REMOTE);
@@ -257,10 +328,9 @@ DFhackCExport RPCService *plugin_rpcconnect(color_ostream &)
     svc->addFunction("GetUnitListInside", GetUnitListInside, SF_ALLOW_REMOTE);
     svc->addFunction("GetViewInfo", GetViewInfo, SF_ALLOW_REMOTE);
     svc->addFunction("GetMapInfo", GetMapInfo, SF_ALLOW_REMOTE);
-    svc->addFunction("ResetMapHashes", ResetMapHashes, SF_ALLOW_REMOTE);
     svc->addFunction("GetItemList", GetItemList, SF_ALLOW_REMOTE);
     svc->addFunction("GetBuildingDefList", GetBuildingDefList, SF_ALLOW_REMOTE);
-    svc->addFunction("GetWorldMap", GetWorldMap, SF_ALLOW_REMOTE);
+    svc->addStagedFunction("GetWorldMap", SnapshotWorldMap, GetWorldMap, SF_ALLOW_REMOTE);
     svc->addFunction("GetWorldMapNew", GetWorldMapNew, SF_ALLOW_REMOTE);
     svc->addFunction("GetRegionMaps", GetRegionMaps, SF_ALLOW_REMOTE);
     svc->addFunction("GetRegionMapsNew", GetRegionMapsNew, SF_ALLOW_REMOTE);
@@ -269,7 +339,7 @@ DFhackCExport RPCService *plugin_rpcconnect(color_ostream &)
     svc->addFunction("GetWorldMapCenter", GetWorldMapCenter, SF_ALLOW_REMOTE);
     svc->addFunction("GetPlantRaws", GetPlantRaws, SF_ALLOW_REMOTE);
     svc->addFunction("GetPartialPlantRaws", GetPartialPlantRaws, SF_ALLOW_REMOTE);
-    svc->addFunction("CopyScreen", CopyScreen, SF_ALLOW_REMOTE);
+    svc->addStagedFunction("CopyScreen", SnapshotScreen, CopyScreen, SF_ALLOW_REMOTE);
     svc->addFunction("PassKeyboardEvent", PassKeyboardEvent, SF_ALLOW_REMOTE);
     svc->addFunction("SendDigCommand", SendDigCommand, SF_ALLOW_REMOTE);
     svc->addFunction("SetPauseState", SetPauseState, SF_ALLOW_REMOTE);
@@ -305,21 +375,22 @@ DFhackCExport command_result plugin_onupdate(color_ostream &out)
 
 uint16_t fletcher16(uint8_t const *data, size_t bytes)
 {
-    uint16_t sum1 = 0xff, sum2 = 0xff;
+    // 32-bit accumulators let us defer the modular reduction for up to 5802
+    // bytes, so the inner loop is free of branches and reductions and whole
+    // block arrays (512 or 1024 bytes) are summed in a single pass.
+    uint32_t sum1 = 0xff, sum2 = 0xff;
 
     while (bytes) {
-        size_t tlen = bytes > 20 ? 20 : bytes;
+        size_t tlen = bytes > 5802 ? 5802 : bytes;
         bytes -= tlen;
         do {
-            sum2 += sum1 += *data++;
+            sum1 += *data++;
+            sum2 += sum1;
         } while (--tlen);
-        sum1 = (sum1 & 0xff) + (sum1 >> 8);
-        sum2 = (sum2 & 0xff) + (sum2 >> 8);
+        sum1 %= 255;
+        sum2 %= 255;
     }
-    /* Second reduction step to reduce sums to 8 bits */
-    sum1 = (sum1 & 0xff) + (sum1 >> 8);
-    sum2 = (sum2 & 0xff) + (sum2 >> 8);
-    return sum2 << 8 | sum1;
+    return uint16_t(sum2 << 8 | sum1);
 }
 
 void ConvertDfColor(int16_t index, RemoteFortressReader::ColorDefinition * out)
@@ -646,74 +717,65 @@ void CopyMat(RemoteFortressReader::MatPair * mat, int type, int index)
 
 }
 
-std::map<DFCoord, uint16_t> hashes;
-
-bool IsTiletypeChanged(DFCoord pos)
+// Change hashes for every layer of a block, kept together in a flat array
+// indexed by block coordinates.
+struct BlockHashes
 {
-    uint16_t hash;
-    df::map_block * block = Maps::getBlock(pos);
-    if (block)
-        hash = fletcher16((uint8_t*)(block->tiletype), 16 * 16 * (sizeof(df::enums::tiletype::tiletype)));
-    else
-        hash = 0;
-    if (hashes[pos] != hash)
-    {
-        hashes[pos] = hash;
-        return true;
-    }
-    return false;
-}
+    uint16_t tiletype = 0;
+    uint16_t designation = 0;
+    uint16_t spatter = 0;
+    uint8_t building = 0;
+};
 
-std::map<DFCoord, uint16_t> waterHashes;
+static std::vector<BlockHashes> blockHashes;
+static int32_t blockHashesX = 0, blockHashesY = 0, blockHashesZ = 0;
 
-bool IsDesignationChanged(DFCoord pos)
+static BlockHashes * GetBlockHashes(DFCoord pos)
 {
-    uint16_t hash;
-    df::map_block * block = Maps::getBlock(pos);
-    if (block)
-        hash = fletcher16((uint8_t*)(block->designation), 16 * 16 * (sizeof(df::tile_designation)));
-    else
-        hash = 0;
-    if (waterHashes[pos] != hash)
+    int32_t x, y, z;
+    Maps::getSize(x, y, z);
+    if (x != blockHashesX || y != blockHashesY || z != blockHashesZ)
     {
-        waterHashes[pos] = hash;
-        return true;
+        blockHashes.assign(size_t(std::max(x, 0)) * std::max(y, 0) * std::max(z, 0), BlockHashes());
+        blockHashesX = x;
+        blockHashesY = y;
+        blockHashesZ = z;
     }
-    return false;
+    if (pos.x < 0 || pos.x >= x || pos.y < 0 || pos.y >= y || pos.z < 0 || pos.z >= z)
+        return NULL;
+    return &blockHashes[(size_t(pos.z) * y + pos.y) * x + pos.x];
 }
 
-std::map<DFCoord, uint8_t> buildingHashes;
+static void ResetBlockHashes()
+{
+    blockHashes.clear();
+    blockHashesX = blockHashesY = blockHashesZ = 0;
+}
 
-bool IsBuildingChanged(DFCoord pos)
+static uint16_t HashTiletypes(df::map_block * block)
 {
-    df::map_block * block = Maps::getBlock(pos);
-    bool changed = false;
-    for (int x = 0; x < 16; x++)
-        for (int y = 0; y < 16; y++)
-        {
-            auto bld = block->occupancy[x][y].bits.building;
-            if (buildingHashes[pos] != bld)
-            {
-                buildingHashes[pos] = bld;
-                changed = true;
-            }
-        }
-    return changed;
+    if (!block)
+        return 0;
+    return fletcher16((uint8_t*)(block->tiletype), 16 * 16 * (sizeof(df::enums::tiletype::tiletype)));
 }
 
-std::map<DFCoord, uint16_t> spatterHashes;
+static uint16_t HashDesignations(df::map_block * block)
+{
+    if (!block)
+        return 0;
+    return fletcher16((uint8_t*)(block->designation), 16 * 16 * (sizeof(df::tile_designation)));
+}
 
-bool IsspatterChanged(DFCoord pos)
+static uint16_t HashSpatters(df::map_block * block)
 {
-    df::map_block * block = Maps::getBlock(pos);
     std::vector<df::block_square_event_material_spatterst *> materials;
 #if DF_VERSION_INT > 34011
     std::vector<df::block_square_event_item_spatterst *> items;
     if (!Maps::SortBlockEvents(block, NULL, NULL, &materials, NULL, NULL, NULL, &items))
-        return false;
+        return 0;
 #else
     if (!Maps::SortBlockEvents(block, NULL, NULL, &materials, NULL, NULL))
-        return false;
+        return 0;
 #endif
 
     uint16_t hash = 0;
@@ -730,9 +792,78 @@ bool IsspatterChanged(DFCoord pos)
         hash ^= fletcher16((uint8_t*)item, sizeof(df::block_square_event_item_spatterst));
     }
 #endif
-    if (spatterHashes[pos] != hash)
+    return hash;
+}
+
+static uint16_t HashBuildingOccupancy(df::map_block * block)
+{
+    uint8_t buildings[16 * 16];
+    for (int x = 0; x < 16; x++)
+        for (int y = 0; y < 16; y++)
+            buildings[x * 16 + y] = block->occupancy[x][y].bits.building;
+    return fletcher16(buildings, sizeof(buildings));
+}
+
+bool IsTiletypeChanged(DFCoord pos)
+{
+    BlockHashes * hashes = GetBlockHashes(pos);
+    if (!hashes)
+        return false;
+    uint16_t hash = HashTiletypes(Maps::getBlock(pos));
+    if (hashes->tiletype != hash)
     {
-        spatterHashes[pos] = hash;
+        hashes->tiletype = hash;
+        return true;
+    }
+    return false;
+}
+
+bool IsDesignationChanged(DFCoord pos)
+{
+    BlockHashes * hashes = GetBlockHashes(pos);
+    if (!hashes)
+        return false;
+    uint16_t hash = HashDesignations(Maps::getBlock(pos));
+    if (hashes->designation != hash)
+    {
+        hashes->designation = hash;
+        return true;
+    }
+    return false;
+}
+
+bool IsBuildingChanged(DFCoord pos)
+{
+    BlockHashes * hashes = GetBlockHashes(pos);
+    df::map_block * block = Maps::getBlock(pos);
+    if (!hashes || !block)
+        return false;
+    bool changed = false;
+    for (int x = 0; x < 16; x++)
+        for (int y = 0; y < 16; y++)
+        {
+            auto bld = block->occupancy[x][y].bits.building;
+            if (hashes->building != bld)
+            {
+                hashes->building = bld;
+                changed = true;
+            }
+        }
+    return changed;
+}
+
+bool IsspatterChanged(DFCoord pos)
+{
+    BlockHashes * hashes = GetBlockHashes(pos);
+    if (!hashes)
+        return false;
+    df::map_block * block = Maps::getBlock(pos);
+    if (!block)
+        return false;
+    uint16_t hash = HashSpatters(block);
+    if (hashes->spatter != hash)
+    {
+        hashes->spatter = hash;
         return true;
     }
     return false;
@@ -782,12 +913,11 @@ void engravingIsNotNew(int index)
     engravingHashes[index] = false;
 }
 
-static command_result ResetMapHashes(color_ostream &stream, const EmptyMessage *in)
+command_result BlockSubscriptionService::ResetMapHashes(color_ostream &stream, const EmptyMessage *in)
 {
-    hashes.clear();
-    waterHashes.clear();
-    buildingHashes.clear();
-    spatterHashes.clear();
+    ResetBlockHashes();
+    for (auto & entry : subscribers)
+        entry.second.initialized = false;
     itemHashes.clear();
     engravingHashes.clear();
     return CR_OK;
@@ -1560,6 +1690,146 @@ static command_result GetBlockList(color_ostream &stream, const BlockRequest *in
     return CR_OK;
 }
 
+// Items are compared by what is actually sent, so items that move within a
+// block or change state are resent too.
+static uint16_t CopyItemsHashed(df::map_block * block, RemoteFortressReader::MapBlock * NetBlock, MapExtras::MapCache * MC, DFCoord pos)
+{
+    if (block->items.empty())
+        return 0;
+    CopyItems(block, NetBlock, MC, pos);
+    std::string data = NetBlock->SerializeAsString();
+    return fletcher16((uint8_t*)data.data(), data.size());
+}
+
+command_result BlockSubscriptionService::SubscribeBlockList(color_ostream &stream, const BlockRequest *in, RemoteFortressReader::BlockSubscription *out)
+{
+    if (subscribers.size() >= MAX_SUBSCRIPTIONS)
+    {
+        stream.printerr("Too many block subscriptions on this connection (max %zu).\n", MAX_SUBSCRIPTIONS);
+        return CR_FAILURE;
+    }
+
+    int size_x, size_y, size_z;
+    Maps::getSize(size_x, size_y, size_z);
+
+    BlockSubscriber sub;
+    sub.min_x = std::max(in->min_x(), 0);
+    sub.min_y = std::max(in->min_y(), 0);
+    sub.min_z = std::max(in->min_z(), 0);
+    sub.max_x = std::max(std::min(in->max_x(), size_x), sub.min_x);
+    sub.max_y = std::max(std::min(in->max_y(), size_y), sub.min_y);
+    sub.max_z = std::max(std::min(in->max_z(), size_z), sub.min_z);
+    sub.blocks.resize(size_t(sub.max_x - sub.min_x) * (sub.max_y - sub.min_y) * (sub.max_z - sub.min_z));
+
+    int32_t id = next_id++;
+    subscribers.emplace(id, std::move(sub));
+    out->set_subscription_id(id);
+    return CR_OK;
+}
+
+command_result BlockSubscriptionService::UnsubscribeBlockList(color_ostream &stream, const RemoteFortressReader::BlockSubscription *in)
+{
+    subscribers.erase(in->subscription_id());
+    return CR_OK;
+}
+
+command_result BlockSubscriptionService::GetBlockUpdates(color_ostream &stream, const RemoteFortressReader::BlockSubscription *in, BlockList *out)
+{
+    auto it = subscribers.find(in->subscription_id());
+    if (it == subscribers.end())
+    {
+        stream.printerr("Unknown block subscription: %d\n", in->subscription_id());
+        return CR_WRONG_USAGE;
+    }
+    auto & sub = it->second;
+
+    int x, y, z;
+    DFHack::Maps::getPosition(x, y, z);
+    out->set_map_x(x);
+    out->set_map_y(y);
+
+    MapExtras::MapCache MC;
+    bool forceReload = !sub.initialized;
+    bool buildingsChanged = forceReload;
+    RemoteFortressReader::MapBlock *first_block = nullptr;
+    size_t index = 0;
+    for (int zz = sub.min_z; zz < sub.max_z; zz++)
+        for (int yy = sub.min_y; yy < sub.max_y; yy++)
+            for (int xx = sub.min_x; xx < sub.max_x; xx++, index++)
+            {
+                DFCoord pos(xx, yy, zz);
+                df::map_block * block = DFHack::Maps::getBlock(pos);
+                if (!block)
+                    continue;
+                auto & hashes = sub.blocks[index];
+
+                RemoteFortressReader::MapBlock items;
+                uint16_t tileHash = HashTiletypes(block);
+                uint16_t desHash = HashDesignations(block);
+                uint16_t spatterHash = HashSpatters(block);
+                uint16_t buildingHash = HashBuildingOccupancy(block);
+                uint16_t itemHash = CopyItemsHashed(block, &items, &MC, pos);
+
+                bool tileChanged = forceReload || tileHash != hashes.tiletype;
+                bool desChanged = forceReload || desHash != hashes.designation;
+                bool spatterChanged = forceReload || spatterHash != hashes.spatter;
+                bool itemsChanged = (forceReload && !block->items.empty()) || itemHash != hashes.items;
+                bool flows = block->flows.size() > 0;
+                if (buildingHash != hashes.building)
+                    buildingsChanged = true;
+
+                hashes.tiletype = tileHash;
+                hashes.designation = desHash;
+                hashes.spatter = spatterHash;
+                hashes.building = buildingHash;
+                hashes.items = itemHash;
+
+                if (!(tileChanged || desChanged || spatterChanged || itemsChanged || flows))
+                    continue;
+
+                auto net_block = out->add_map_blocks();
+                net_block->set_map_x(block->map_pos.x);
+                net_block->set_map_y(block->map_pos.y);
+                net_block->set_map_z(block->map_pos.z);
+                if (!first_block)
+                    first_block = net_block;
+                if (tileChanged)
+                    CopyBlock(block, net_block, &MC, pos);
+                if (desChanged)
+                    CopyDesignation(block, net_block, &MC, pos);
+                if (spatterChanged)
+                    Copyspatters(block, net_block, &MC, pos);
+                // an empty item list tells the client the last items left the block
+                if (itemsChanged)
+                    net_block->mutable_items()->Swap(items.mutable_items());
+                if (flows)
+                    CopyFlows(block, net_block);
+            }
+
+    // like GetBlockList, all buildings in the region and all projectiles go
+    // in the first block sent; projectiles move every tick, so always send them
+    RemoteFortressReader::MapBlock projectiles;
+    CopyProjectiles(&projectiles);
+    if ((buildingsChanged || projectiles.items_size() > 0) && sub.max_z > sub.min_z)
+    {
+        if (!first_block)
+        {
+            first_block = out->add_map_blocks();
+            first_block->set_map_x(sub.min_x * 16);
+            first_block->set_map_y(sub.min_y * 16);
+            first_block->set_map_z(sub.min_z);
+        }
+        if (buildingsChanged)
+            CopyBuildings(DFCoord(sub.min_x * 16, sub.min_y * 16, sub.min_z), DFCoord(sub.max_x * 16, sub.max_y * 16, sub.max_z), first_block, &MC);
+        for (int i = 0; i < projectiles.items_size(); i++)
+            first_block->add_items()->Swap(projectiles.mutable_items(i));
+    }
+
+    sub.initialized = true;
+    MC.trash();
+    return CR_OK;
+}
+
 static command_result GetTiletypeList(color_ostream &stream, const EmptyMessage *in, TiletypeList *out)
 {
     int count = 0;
@@ -1964,30 +2234,72 @@ static command_result GetWorldMapCenter(color_ostream &stream, const EmptyMessag
     return CR_OK;
 }
 
-static command_result GetWorldMap(color_ostream &stream, const EmptyMessage *in, WorldMap *out)
+static command_result SnapshotWorldMap(color_ostream &stream, const EmptyMessage *in, WorldMapSnapshot *stage)
 {
     if (!df::global::world->world_data)
-    {
-        out->set_world_width(0);
-        out->set_world_height(0);
-        return CR_FAILURE;
-    }
+        return CR_OK;
     df::world_data * data = df::global::world->world_data;
     if (!data->region_map)
-    {
-        out->set_world_width(0);
-        out->set_world_height(0);
-        return CR_FAILURE;
-    }
+        return CR_OK;
     int width = data->world_width;
     int height = data->world_height;
-    out->set_world_width(width);
-    out->set_world_height(height);
-    out->set_name(DF2UTF(Translation::TranslateName(&(data->name), false)));
-    out->set_name_english(DF2UTF(Translation::TranslateName(&(data->name), true)));
-    auto poles = data->flip_latitude;
+    stage->width = width;
+    stage->height = height;
+    stage->name = Translation::TranslateName(&(data->name), false);
+    stage->name_english = Translation::TranslateName(&(data->name), true);
 #if DF_VERSION_INT > 34011
-    switch (poles)
+    stage->poles = data->flip_latitude;
+#endif
+    stage->tiles.resize(size_t(width) * height);
+    auto tile = stage->tiles.begin();
+    for (int yy = 0; yy < height; yy++)
+        for (int xx = 0; xx < width; xx++, ++tile)
+        {
+            df::region_map_entry * map_entry = &data->region_map[xx][yy];
+            df::world_region * region = data->regions[map_entry->region_id];
+            tile->elevation = map_entry->elevation;
+            tile->rainfall = map_entry->rainfall;
+            tile->vegetation = map_entry->vegetation;
+            tile->temperature = map_entry->temperature;
+            tile->evilness = map_entry->evilness;
+            tile->drainage = map_entry->drainage;
+            tile->volcanism = map_entry->volcanism;
+            tile->savagery = map_entry->savagery;
+            tile->salinity = map_entry->salinity;
+#if DF_VERSION_INT > 34011
+            tile->cirrus = map_entry->clouds.bits.cirrus;
+            tile->cumulus = map_entry->clouds.bits.cumulus;
+            tile->fog = map_entry->clouds.bits.fog;
+            tile->front = map_entry->clouds.bits.front;
+            tile->stratus = map_entry->clouds.bits.stratus;
+#else
+            tile->cirrus = map_entry->clouds.bits.striped;
+            tile->cumulus = map_entry->clouds.bits.density;
+            tile->fog = map_entry->clouds.bits.fog;
+            tile->front = 0;
+            tile->stratus = map_entry->clouds.bits.darkness;
+#endif
+            if (region->type == world_region_type::Lake)
+                tile->water_elevation = region->lake_surface;
+            else
+                tile->water_elevation = 99;
+        }
+    stage->center = GetMapCenter();
+    stage->cur_year = World::ReadCurrentYear();
+    stage->cur_year_tick = World::ReadCurrentTick();
+    return CR_OK;
+}
+
+static command_result GetWorldMap(color_ostream &stream, const EmptyMessage *in, const WorldMapSnapshot *stage, WorldMap *out)
+{
+    out->set_world_width(stage->width);
+    out->set_world_height(stage->height);
+    if (stage->tiles.empty())
+        return CR_FAILURE;
+    out->set_name(DF2UTF(stage->name));
+    out->set_name_english(DF2UTF(stage->name_english));
+#if DF_VERSION_INT > 34011
+    switch (stage->poles)
     {
     case df::world_data::None:
         out->set_world_poles(WorldPoles::NO_POLES);
@@ -2007,48 +2319,33 @@ static command_result GetWorldMap(color_ostream &stream, const EmptyMessage *in,
 #else
     out->set_world_poles(WorldPoles::NO_POLES);
 #endif
-    for (int yy = 0; yy < height; yy++)
-        for (int xx = 0; xx < width; xx++)
-        {
-            df::region_map_entry * map_entry = &data->region_map[xx][yy];
-            df::world_region * region = data->regions[map_entry->region_id];
-            out->add_elevation(map_entry->elevation);
-            out->add_rainfall(map_entry->rainfall);
-            out->add_vegetation(map_entry->vegetation);
-            out->add_temperature(map_entry->temperature);
-            out->add_evilness(map_entry->evilness);
-            out->add_drainage(map_entry->drainage);
-            out->add_volcanism(map_entry->volcanism);
-            out->add_savagery(map_entry->savagery);
-            out->add_salinity(map_entry->salinity);
-            auto clouds = out->add_clouds();
+    for (auto & tile : stage->tiles)
+    {
+        out->add_elevation(tile.elevation);
+        out->add_rainfall(tile.rainfall);
+        out->add_vegetation(tile.vegetation);
+        out->add_temperature(tile.temperature);
+        out->add_evilness(tile.evilness);
+        out->add_drainage(tile.drainage);
+        out->add_volcanism(tile.volcanism);
+        out->add_savagery(tile.savagery);
+        out->add_salinity(tile.salinity);
+        auto clouds = out->add_clouds();
+        clouds->set_cirrus(tile.cirrus);
+        clouds->set_cumulus((RemoteFortressReader::CumulusType)tile.cumulus);
+        clouds->set_fog((RemoteFortressReader::FogType)tile.fog);
 #if DF_VERSION_INT > 34011
-            clouds->set_cirrus(map_entry->clouds.bits.cirrus);
-            clouds->set_cumulus((RemoteFortressReader::CumulusType)map_entry->clouds.bits.cumulus);
-            clouds->set_fog((RemoteFortressReader::FogType)map_entry->clouds.bits.fog);
-            clouds->set_front((RemoteFortressReader::FrontType)map_entry->clouds.bits.front);
-            clouds->set_stratus((RemoteFortressReader::StratusType)map_entry->clouds.bits.stratus);
-#else
-            clouds->set_cirrus(map_entry->clouds.bits.striped);
-            clouds->set_cumulus((RemoteFortressReader::CumulusType)map_entry->clouds.bits.density);
-            clouds->set_fog((RemoteFortressReader::FogType)map_entry->clouds.bits.fog);
-            clouds->set_stratus((RemoteFortressReader::StratusType)map_entry->clouds.bits.darkness);
+        clouds->set_front((RemoteFortressReader::FrontType)tile.front);
 #endif
-            if (region->type == world_region_type::Lake)
-            {
-                out->add_water_elevation(region->lake_surface);
-            }
-            else
-                out->add_water_elevation(99);
-        }
-    DFCoord pos = GetMapCenter();
-    out->set_center_x(pos.x);
-    out->set_center_y(pos.y);
-    out->set_center_z(pos.z);
-
+        clouds->set_stratus((RemoteFortressReader::StratusType)tile.stratus);
+        out->add_water_elevation(tile.water_elevation);
+    }
+    out->set_center_x(stage->center.x);
+    out->set_center_y(stage->center.y);
+    out->set_center_z(stage->center.z);
 
-    out->set_cur_year(World::ReadCurrentYear());
-    out->set_cur_year_tick(World::ReadCurrentTick());
+    out->set_cur_year(stage->cur_year);
+    out->set_cur_year_tick(stage->cur_year_tick);
     return CR_OK;
 }
 
@@ -2880,18 +3177,27 @@ static command_result GetPartialPlantRaws(color_ostream &stream, const ListReque
     return CR_OK;
 }
 
-static command_result CopyScreen(color_ostream &stream, const EmptyMessage *in, ScreenCapture *out)
+static command_result SnapshotScreen(color_ostream &stream, const EmptyMessage *in, ScreenSnapshot *stage)
 {
     df::graphic * gps = df::global::gps;
-    out->set_width(gps->dimx);
-    out->set_height(gps->dimy);
-    for (int i = 0; i < (gps->dimx * gps->dimy); i++)
+    stage->width = gps->dimx;
+    stage->height = gps->dimy;
+    stage->screen.assign(gps->screen, gps->screen + (gps->dimx * gps->dimy * 4));
+    return CR_OK;
+}
+
+static command_result CopyScreen(color_ostream &stream, const EmptyMessage *in, const ScreenSnapshot *stage, ScreenCapture *out)
+{
+    auto & screen = stage->screen;
+    out->set_width(stage->width);
+    out->set_height(stage->height);
+    for (int i = 0; i < (stage->width * stage->height); i++)
     {
         int index = i * 4;
         auto tile = out->add_tiles();
-        tile->set_character(gps->screen[index]);
-        tile->set_foreground(gps->screen[index + 1] | (gps->screen[index + 3] * 8));
-        tile->set_background(gps->screen[index + 2]);
+        tile->set_character(screen[index]);
+        tile->set_foreground(screen[index + 1] | (screen[index + 3] * 8));
+        tile->set_background(screen[index + 2]);
     }
 
     return CR_OK;
@@ -217,7 +217,7 @@ static void init_buildings(bool enable)
 
         if (entry.isValid())
         {
-            std::string val = entry.val();
+            std::string val = entry.get_str();
             for (size_t i = 0; i < val.size(); i++)
                 enable_building_rename(val[i], true);
         }
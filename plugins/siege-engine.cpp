@@ -457,59 +457,59 @@ static void load_engines()
     World::GetPersistentData(&vec, "siege-engine/target/", true);
     for (auto it = vec.begin(); it != vec.end(); ++it)
     {
-        auto engine = find_engine(df::building::find(it->ival(0)), true);
+        auto engine = find_engine(df::building::find(it->get_int(0)), true);
         if (!engine) continue;
-        engine->target.first = df::coord(it->ival(1), it->ival(2), it->ival(3));
-        engine->target.second = df::coord(it->ival(4), it->ival(5), it->ival(6));
+        engine->target.first = df::coord(it->get_int(1), it->get_int(2), it->get_int(3));
+        engine->target.second = df::coord(it->get_int(4), it->get_int(5), it->get_int(6));
     }
 
     World::GetPersistentData(&vec, "siege-engine/ammo/", true);
     for (auto it = vec.begin(); it != vec.end(); ++it)
     {
-        auto engine = find_engine(df::building::find(it->ival(0)), true);
+        auto engine = find_engine(df::building::find(it->get_int(0)), true);
         if (!engine) continue;
-        engine->ammo_vector_id = (df::job_item_vector_id)it->ival(1);
-        engine->ammo_item_type = (df::item_type)it->ival(2);
+        engine->ammo_vector_id = (df::job_item_vector_id)it->get_int(1);
+        engine->ammo_item_type = (df::item_type)it->get_int(2);
     }
 
     World::GetPersistentData(&vec, "siege-engine/stockpiles/", true);
     for (auto it = vec.begin(); it != vec.end(); ++it)
     {
-        auto engine = find_engine(df::building::find(it->ival(0)), true);
+        auto engine = find_engine(df::building::find(it->get_int(0)), true);
         if (!engine)
             continue;
-        auto pile = df::building::find(it->ival(1));
+        auto pile = df::building::find(it->get_int(1));
         if (!pile || pile->getType() != building_type::Stockpile)
         {
             World::DeletePersistentData(*it);
             continue;;
         }
 
-        engine->stockpiles.insert(it->ival(1));
+        engine->stockpiles.insert(it->get_int(1));
     }
 
     World::GetPersistentData(&vec, "siege-engine/profiles/", true);
     for (auto it = vec.begin(); it != vec.end(); ++it)
     {
-        auto engine = find_engine(df::building::find(it->ival(0)), true);
+        auto engine = find_engine(df::building::find(it->get_int(0)), true);
         if (!engine) continue;
-        engine->profile.min_level = it->ival(1);
-        engine->profile.max_level = it->ival(2);
+        engine->profile.min_level = it->get_int(1);
+        engine->profile.max_level = it->get_int(2);
     }
 
     World::GetPersistentData(&vec, "siege-engine/profile-workers/", true);
     for (auto it = vec.begin(); it != vec.end(); ++it)
     {
-        auto engine = find_engine(df::building::find(it->ival(0)), true);
+        auto engine = find_engine(df::building::find(it->get_int(0)), true);
         if (!engine)
             continue;
-        auto unit = df::unit::find(it->ival(1));
+        auto unit = df::unit::find(it->get_int(1));
         if (!unit || !Units::isCitizen(unit))
         {
             World::DeletePersistentData(*it);
             continue;
         }
-        engine->profile.permitted_workers.push_back(it->ival(1));
+        engine->profile.permitted_workers.push_back(it->get_int(1));
     }
 }
 
@@ -560,13 +560,13 @@ static bool setTargetArea(df::building_siegeenginest *bld, df::coord target_min,
 
     set_range(&engine->target, target_min, target_max);
 
-    entry.ival(0) = bld->id;
-    entry.ival(1) = engine->target.first.x;
-    entry.ival(2) = engine->target.first.y;
-    entry.ival(3) = engine->target.first.z;
-    entry.ival(4) = engine->target.second.x;
-    entry.ival(5) = engine->target.second.y;
-    entry.ival(6) = engine->target.second.z;
+    entry.set_int(0, bld->id);
+    entry.set_int(1, engine->target.first.x);
+    entry.set_int(2, engine->target.first.y);
+    entry.set_int(3, engine->target.first.z);
+    entry.set_int(4, engine->target.second.x);
+    entry.set_int(5, engine->target.second.y);
+    entry.set_int(6, engine->target.second.z);
 
     df::coord sum = target_min + target_max;
     orient_engine(bld, df::coord(sum.x/2, sum.y/2, sum.z/2));
@@ -613,9 +613,9 @@ static int setAmmoItem(lua_State *L)
         }
     }
 
-    entry.ival(0) = engine->id;
-    entry.ival(1) = engine->ammo_vector_id;
-    entry.ival(2) = engine->ammo_item_type;
+    entry.set_int(0, engine->id);
+    entry.set_int(1, engine->ammo_vector_id);
+    entry.set_int(2, engine->ammo_item_type);
 
     lua_pushboolean(L, true);
     return 1;
@@ -692,8 +692,8 @@ static bool addStockpileLink(df::building_siegeenginest *bld, df::building_stock
 
     auto engine = find_engine(bld, true);
 
-    entry.ival(0) = bld->id;
-    entry.ival(1) = pile->id;
+    entry.set_int(0, bld->id);
+    entry.set_int(1, pile->id);
 
     engine->stockpiles.insert(pile->id);
     return true;
@@ -729,9 +729,9 @@ static df::workshop_profile *saveWorkshopProfile(df::building_siegeenginest *bld
 
     auto engine = find_engine(bld, true);
 
-    entry.ival(0) = engine->id;
-    entry.ival(1) = engine->profile.min_level;
-    entry.ival(2) = engine->profile.max_level;
+    entry.set_int(0, engine->id);
+    entry.set_int(1, engine->profile.min_level);
+    entry.set_int(2, engine->profile.max_level);
 
     // Save worker list
     std::vector<PersistentDataItem> vec;
@@ -742,7 +742,7 @@ static df::workshop_profile *saveWorkshopProfile(df::building_siegeenginest *bld
 
     for (auto it = vec.begin(); it != vec.end(); ++it)
     {
-        if (linear_index(workers, it->ival(1)) < 0)
+        if (linear_index(workers, it->get_int(1)) < 0)
             World::DeletePersistentData(*it);
     }
 
@@ -752,8 +752,8 @@ static df::workshop_profile *saveWorkshopProfile(df::building_siegeenginest *bld
         entry = World::GetPersistentData(key, NULL);
         if (!entry.isValid())
             continue;
-        entry.ival(0) = engine->id;
-        entry.ival(1) = workers[i];
+        entry.set_int(0, engine->id);
+        entry.set_int(1, workers[i]);
     }
 
     return &engine->profile;
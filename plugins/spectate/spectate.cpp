@@ -158,12 +158,12 @@ namespace SP {
 
     void SaveSettings() {
         if (pconfig.isValid()) {
-            pconfig.ival(UNPAUSE) = config.unpause;
-            pconfig.ival(DISENGAGE) = config.disengage;
-            pconfig.ival(TICK_THRESHOLD) = config.tick_threshold;
-            pconfig.ival(ANIMALS) = config.animals;
-            pconfig.ival(HOSTILES) = config.hostiles;
-            pconfig.ival(VISITORS) = config.visitors;
+            pconfig.set_int(UNPAUSE, config.unpause);
+            pconfig.set_int(DISENGAGE, config.disengage);
+            pconfig.set_int(TICK_THRESHOLD, config.tick_threshold);
+            pconfig.set_int(ANIMALS, config.animals);
+            pconfig.set_int(HOSTILES, config.hostiles);
+            pconfig.set_int(VISITORS, config.visitors);
         }
     }
 
@@ -174,12 +174,12 @@ namespace SP {
             pconfig = World::AddPersistentSiteData(CONFIG_KEY);
             SaveSettings();
         } else {
-            config.unpause = pconfig.ival(UNPAUSE);
-            config.disengage = pconfig.ival(DISENGAGE);
-            config.tick_threshold = pconfig.ival(TICK_THRESHOLD);
-            config.animals = pconfig.ival(ANIMALS);
-            config.hostiles = pconfig.ival(HOSTILES);
-            config.visitors = pconfig.ival(VISITORS);
+            config.unpause = pconfig.get_int(UNPAUSE);
+            config.disengage = pconfig.get_int(DISENGAGE);
+            config.tick_threshold = pconfig.get_int(TICK_THRESHOLD);
+            config.animals = pconfig.get_int(ANIMALS);
+            config.hostiles = pconfig.get_int(HOSTILES);
+            config.visitors = pconfig.get_int(VISITORS);
             pause_lock->unlock();
             SetUnpauseState(config.unpause);
         }
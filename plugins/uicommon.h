@@ -375,7 +375,7 @@ public:
     PersistentStockpileInfo(PersistentDataItem &config, string persistence_key) :
         config(config), persistence_key(persistence_key)
     {
-        id = config.ival(1);
+        id = config.get_int(1);
     }
 
     bool load()
@@ -396,7 +396,7 @@ public:
     void save()
     {
         config = DFHack::World::AddPersistentData(persistence_key);
-        config.ival(1) = id;
+        config.set_int(1, id);
     }
 
     void remove()
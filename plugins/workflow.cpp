@@ -274,30 +274,30 @@ public:
         mat_mask.whole = 0; // see https://github.com/DFHack/dfhack/issues/1047
     }
 
-    int goalCount() { return config.ival(0); }
-    void setGoalCount(int v) { config.ival(0) = v; }
+    int goalCount() { return config.get_int(0); }
+    void setGoalCount(int v) { config.set_int(0, v); }
 
     int goalGap() {
-        int cval = (config.ival(1) <= 0) ? std::min(5,goalCount()/2) : config.ival(1);
+        int cval = (config.get_int(1) <= 0) ? std::min(5,goalCount()/2) : config.get_int(1);
         return std::max(1, std::min(goalCount()-1, cval));
     }
-    void setGoalGap(int v) { config.ival(1) = v; }
+    void setGoalGap(int v) { config.set_int(1, v); }
 
-    bool goalByCount() { return config.ival(2) & 1; }
+    bool goalByCount() { return config.get_int(2) & 1; }
     void setGoalByCount(bool v) {
         if (v)
-            config.ival(2) |= 1;
+            config.set_int(2, config.get_int(2) | 1);
         else
-            config.ival(2) &= ~1;
+            config.set_int(2, config.get_int(2) & ~1);
     }
 
     int curItemStock() { return goalByCount() ? item_count : item_amount; }
 
     void init(const std::string &str)
     {
-        config.val() = str;
-        config.ival(0) = 10;
-        config.ival(2) = 0;
+        config.set_str(str);
+        config.set_int(0, 10);
+        config.set_int(2, 0);
     }
 
     void computeRequest()
@@ -315,7 +315,7 @@ public:
     }
     int history_value(int idx, HistoryItem item) {
         size_t hsize = history_size();
-        size_t base = ((history.ival(0)+1+idx) % hsize) * hist_entry_size;
+        size_t base = ((history.get_int(0)+1+idx) % hsize) * hist_entry_size;
         return history.get_int28(base + item*int28_size);
     }
     int history_count(int idx) { return history_value(idx, HIST_COUNT); }
@@ -326,11 +326,11 @@ public:
     void updateHistory()
     {
         size_t buffer_size = history_size();
-        if (buffer_size < MAX_HISTORY_SIZE && size_t(history.ival(0)+1) == buffer_size)
+        if (buffer_size < MAX_HISTORY_SIZE && size_t(history.get_int(0)+1) == buffer_size)
             history.ensure_data(hist_entry_size*++buffer_size);
-        history.ival(0) = (history.ival(0)+1) % buffer_size;
+        history.set_int(0, (history.get_int(0)+1) % buffer_size);
 
-        size_t base = history.ival(0) * hist_entry_size;
+        size_t base = history.get_int(0) * hist_entry_size;
 
         history.set_int28(base + HIST_COUNT*int28_size, item_count);
         history.set_int28(base + HIST_AMOUNT*int28_size, item_amount);
@@ -388,7 +388,7 @@ static bool isSupportedJob(df::job *job)
 
 static bool isOptionEnabled(unsigned flag)
 {
-    return config.isValid() && (config.ival(0) & flag) != 0;
+    return config.isValid() && (config.get_int(0) & flag) != 0;
 }
 
 static void setOptionEnabled(ConfigFlags flag, bool on)
@@ -397,9 +397,9 @@ static void setOptionEnabled(ConfigFlags flag, bool on)
         return;
 
     if (on)
-        config.ival(0) |= flag;
+        config.set_int(0, config.get_int(0) | flag);
     else
-        config.ival(0) &= ~flag;
+        config.set_int(0, config.get_int(0) & ~flag);
 }
 
 /******************************
@@ -444,8 +444,8 @@ static void start_protect(color_ostream &out)
 static void init_state(color_ostream &out)
 {
     config = World::GetPersistentSiteData("workflow/config");
-    if (config.isValid() && config.ival(0) == -1)
-        config.ival(0) = 0;
+    if (config.isValid() && config.get_int(0) == -1)
+        config.set_int(0, 0);
 
     enabled = isOptionEnabled(CF_ENABLED);
 
@@ -454,10 +454,10 @@ static void init_state(color_ostream &out)
     World::GetPersistentSiteData(&items, "workflow/constraints");
 
     for (int i = items.size()-1; i >= 0; i--) {
-        if (get_constraint(out, items[i].val(), &items[i]))
+        if (get_constraint(out, items[i].get_str(), &items[i]))
             continue;
 
-        out.printerr("Lost constraint %s\n", items[i].val().c_str());
+        out.printerr("Lost constraint %s\n", items[i].get_str().c_str());
         World::DeletePersistentData(items[i]);
     }
 
@@ -475,7 +475,7 @@ static void enable_plugin(color_ostream &out)
     if (!config.isValid())
     {
         config = World::AddPersistentSiteData("workflow/config");
-        config.ival(0) = 0;
+        config.set_int(0, 0);
     }
 
     setOptionEnabled(CF_ENABLED, true);
@@ -787,7 +787,7 @@ static bool deleteConstraint(std::string name)
 {
     for (size_t i = 0; i < constraints.size(); i++)
     {
-        if (constraints[i]->config.val() != name)
+        if (constraints[i]->config.get_str() != name)
             continue;
 
         delete_constraint(constraints[i]);
@@ -1357,7 +1357,7 @@ static void push_constraint(lua_State *L, ItemConstraint *cv)
     int ctable = lua_gettop(L);
 
     Lua::SetField(L, -cv->config.fake_df_id(), ctable, "id");
-    Lua::SetField(L, cv->config.val(), ctable, "token");
+    Lua::SetField(L, cv->config.get_str(), ctable, "token");
 
     // Constraint key
 
@@ -1569,7 +1569,7 @@ static void print_constraint(color_ostream &out, ItemConstraint *cv, bool no_job
     out.color(color);
     out << prefix << "Constraint " << flush;
     out.color(COLOR_GREY);
-    out << cv->config.val() << " " << flush;
+    out << cv->config.get_str() << " " << flush;
     out.color(color);
     out << (cv->goalByCount() ? "count " : "amount ")
            << cv->goalCount() << " (gap " << cv->goalGap() << ")" << endl;
@@ -1781,7 +1781,7 @@ static command_result workflow_cmd(color_ostream &out, vector <string> & paramet
         {
             auto cv = constraints[i];
             out << "workflow " << (cv->goalByCount() ? "count " : "amount ")
-                << cv->config.val() << " " << cv->goalCount() << " " << cv->goalGap() << endl;
+                << cv->config.get_str() << " " << cv->goalCount() << " " << cv->goalGap() << endl;
         }
 
         return CR_OK;
@@ -315,6 +315,7 @@ config.wrapper = function(test_fn)
         {h.dfhack.filesystem, 'listdir_recursive', mock_listdir_recursive},
         {h.dfhack, 'getTickCount', mock_getTickCount},
         {h, 'pcall', mock_pcall},
+        {h, 'cache_path', false},
     }, test_fn)
 end
 
@@ -560,9 +561,9 @@ function test.search_entries()
         'enable', 'fpause', 'hascommands', 'help', 'hide', 'inscript_docs',
         'inscript_short_only', 'keybinding', 'kill-lua', 'load', 'ls', 'man',
         'nocommand', 'nodoc_command', 'nodocs_hascommands', 'nodocs_nocommand',
-        'nodocs_samename', 'nodocs_script', 'plug', 'reload', 'samename',
-        'script', 'subdir/scriptname', 'sc-script', 'show', 'tags', 'type',
-        'unload'}
+        'nodocs_samename', 'nodocs_script', 'plug', 'devel/profile', 'reload',
+        'samename', 'script', 'subdir/scriptname', 'sc-script', 'show', 'tags',
+        'type', 'unload'}
     table.sort(expected, h.sort_by_basename)
     expect.table_eq(expected, h.search_entries())
     expect.table_eq(expected, h.search_entries({}))
@@ -598,9 +599,9 @@ function test.get_commands()
         'clear', 'cls', 'dev_script', 'die', 'dir', 'disable', 'devel/dump-rpc',
         'enable', 'fpause', 'help', 'hide', 'inscript_docs', 'inscript_short_only',
         'keybinding', 'kill-lua', 'load', 'ls', 'man', 'nodoc_command',
-        'nodocs_samename', 'nodocs_script', 'plug', 'reload', 'samename',
-        'script', 'subdir/scriptname', 'sc-script', 'show', 'tags', 'type',
-        'unload'}
+        'nodocs_samename', 'nodocs_script', 'plug', 'devel/profile', 'reload',
+        'samename', 'script', 'subdir/scriptname', 'sc-script', 'show', 'tags',
+        'type', 'unload'}
     table.sort(expected, h.sort_by_basename)
     expect.table_eq(expected, h.get_commands())
 end
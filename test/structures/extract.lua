@@ -0,0 +1,73 @@
+config.target = 'core'
+
+local function with_job_items(count, fn)
+    dfhack.with_temp_object(df.job:new(), function(job)
+        for i = 1, count do
+            job.items:insert('#', {new=true, role=df.job_item_ref.T_role.Hauled,
+                                   is_fetching=i % 2, job_item_idx=i})
+        end
+        dfhack.with_finally(function()
+            for _, ref in ipairs(job.items) do
+                ref:delete()
+            end
+            job.items:resize(0)
+        end, fn, job)
+    end)
+end
+
+function test.columns()
+    with_job_items(5, function(job)
+        local data, n = df.extract(job.items, {'job_item_idx', 'is_fetching', 'role'})
+        expect.eq(5, n)
+        expect.eq(5, #data.job_item_idx)
+        for i = 1, n do
+            expect.eq(i, data.job_item_idx[i])
+            expect.eq(i % 2, data.is_fetching[i])
+            expect.eq(df.job_item_ref.T_role.Hauled, data.role[i])
+        end
+    end)
+end
+
+function test.empty()
+    with_job_items(0, function(job)
+        local data, n = df.extract(job.items, {'job_item_idx'})
+        expect.eq(0, n)
+        expect.table_eq({job_item_idx={}}, data)
+    end)
+end
+
+function test.substructure_path()
+    local units = df.global.world.units.all
+    local data, n = df.extract(units, {'id', 'pos.x', 'pos.z'})
+    expect.eq(#units, n)
+    for i, unit in ipairs(units) do
+        expect.eq(unit.id, data.id[i + 1])
+        expect.eq(unit.pos.x, data['pos.x'][i + 1])
+        expect.eq(unit.pos.z, data['pos.z'][i + 1])
+    end
+end
+
+function test.errors()
+    with_job_items(1, function(job)
+        expect.error_match('field not found', function()
+            df.extract(job.items, {'nonexistent'})
+        end)
+        expect.error_match('not a primitive field', function()
+            df.extract(job.items, {'item'})
+        end)
+        expect.error_match('not a substructure', function()
+            df.extract(job.items, {'job_item_idx.x'})
+        end)
+        expect.error_match('container expected', function()
+            df.extract(job, {'id'})
+        end)
+    end)
+end
+
+function test.primitive_container()
+    dfhack.with_temp_object(df.unit:new(), function(unit)
+        expect.error_match('container of structures expected', function()
+            df.extract(unit.path.path.x, {'x'})
+        end)
+    end)
+end
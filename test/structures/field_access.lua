@@ -0,0 +1,93 @@
+config.target = 'core'
+
+local ITERATIONS = 1000000
+
+local INTEGER_TYPES = {
+    int8_t={-128, 127}, uint8_t={0, 255},
+    int16_t={-32768, 32767}, uint16_t={0, 65535},
+    int32_t={-2147483648, 2147483647}, uint32_t={0, 4294967295},
+}
+
+local FLOAT_TYPES = {float=true, double=true}
+
+local MODE_PRIMITIVE = 1
+
+function test.primitive_roundtrip()
+    dfhack.with_temp_object(df.unit:new(), function(unit)
+        local checked = 0
+        for name, info in pairs(df.unit._fields) do
+            local range = INTEGER_TYPES[info.type_name]
+            if info.mode ~= MODE_PRIMITIVE then
+                -- only plain scalar fields use the direct accessors
+            elseif range then
+                for _, value in ipairs(range) do
+                    unit[name] = value
+                    expect.eq(value, unit[name], name)
+                end
+                checked = checked + 1
+            elseif FLOAT_TYPES[info.type_name] then
+                unit[name] = 0.5
+                expect.eq(0.5, unit[name], name)
+                checked = checked + 1
+            elseif info.type_name == 'bool' then
+                unit[name] = true
+                expect.true_(unit[name], name)
+                unit[name] = 0
+                expect.false_(unit[name], name)
+                checked = checked + 1
+            end
+        end
+        expect.lt(0, checked)
+    end)
+end
+
+function test.integer_truncation()
+    dfhack.with_temp_object(df.coord:new(), function(pos)
+        pos.x = 40000
+        expect.eq(40000 - 65536, pos.x)
+        pos.y = -1
+        expect.eq(-1, pos.y)
+    end)
+end
+
+function test.enum_field()
+    dfhack.with_temp_object(df.unit:new(), function(unit)
+        unit.profession = df.profession.MINER
+        expect.eq(df.profession.MINER, unit.profession)
+    end)
+end
+
+function test.write_errors()
+    dfhack.with_temp_object(df.coord:new(), function(pos)
+        expect.error_match('integer expected', function() pos.x = 'abc' end)
+        expect.error_match('integer expected', function() pos.x = {} end)
+        expect.error_match('not found', function() pos.nonexistent = 1 end)
+    end)
+end
+
+-- microbenchmark for the compiled field accessors behind obj.field
+function test.field_access_throughput()
+    dfhack.with_temp_object(df.coord:new(), function(pos)
+        local start = os.clock()
+        for i = 1, ITERATIONS do
+            pos.x = pos.y + 1
+        end
+        local elapsed = os.clock() - start
+        expect.eq(1, pos.x)
+        print(('%d field reads + writes in %.3f s (%.0f accesses/s)'):format(
+            ITERATIONS, elapsed, elapsed > 0 and 2 * ITERATIONS / elapsed or 0))
+    end)
+
+    dfhack.with_temp_object(df.unit:new(), function(unit)
+        local start = os.clock()
+        local n = 0
+        for i = 1, ITERATIONS do
+            local pos = unit.pos
+            n = n + pos.z
+        end
+        local elapsed = os.clock() - start
+        expect.eq(ITERATIONS * unit.pos.z, n)
+        print(('%d substructure reads in %.3f s (%.0f reads/s)'):format(
+            ITERATIONS, elapsed, elapsed > 0 and ITERATIONS / elapsed or 0))
+    end)
+end
@@ -0,0 +1,50 @@
+config.target = 'core'
+
+local function make_instances()
+    local objs = {}
+    for name, type in pairs(df) do
+        if name:startswith('item_') and name:endswith('st') and type._kind == 'class-type' then
+            local ok, obj = pcall(type.new, type)
+            if ok and obj then
+                table.insert(objs, {obj=obj, type=type})
+            end
+        end
+    end
+    return objs
+end
+
+local function free_instances(objs)
+    for _, entry in ipairs(objs) do
+        entry.obj:delete()
+    end
+end
+
+function test.is_instance()
+    local objs = make_instances()
+    expect.lt(0, #objs)
+    for _, entry in ipairs(objs) do
+        expect.true_(df.item:is_instance(entry.obj), tostring(entry.type))
+        expect.true_(entry.type:is_instance(entry.obj), tostring(entry.type))
+        expect.false_(df.unit:is_instance(entry.obj), tostring(entry.type))
+    end
+    free_instances(objs)
+end
+
+-- repeated casts go through the vtable cache and must agree with the first,
+-- uncached lookup, including negative results
+function test.is_instance_repeated()
+    local objs = make_instances()
+    expect.lt(0, #objs)
+    for _, entry in ipairs(objs) do
+        local name = tostring(entry.type)
+        local first = entry.type:is_instance(entry.obj)
+        local first_neg = df.unit:is_instance(entry.obj)
+        for i = 1, 3 do
+            expect.eq(first, entry.type:is_instance(entry.obj), name)
+            expect.eq(first_neg, df.unit:is_instance(entry.obj), name)
+        end
+        expect.true_(first, name)
+        expect.false_(first_neg, name)
+    end
+    free_instances(objs)
+end